@@ -0,0 +1,167 @@
+/*
+ *  ahefutil accenc -p public_key.json -a total.json new1.enc new2.enc ...
+ *  ahefutil accenc -p public_key.json -a total.json -C new_readings.txt
+ *
+ *  Fold newly arrived ciphertexts into an accumulator, an aggregate file holding
+ *  the running encrypted sum and count. Only the new ciphertexts are read, so an
+ *  update costs O(new) homomorphic additions instead of re-summing everything.
+ *
+ *  A missing accumulator is created as E(0) with count 0 (with -q it also keeps
+ *  E(Σx²)). Concurrent updaters are serialized with flock(2) on "<accumulator>.lock",
+ *  and the new state is written to a temporary file and renamed over the old one,
+ *  so a crash leaves either the previous or the updated accumulator on disk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// take an exclusive lock on "<path>.lock", released when the process exits
+static int lock_accumulator (const std::string &path)
+{
+    std::string lockFile = path + ".lock";
+    int fd = open(lockFile.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0)
+        throw std::runtime_error("cannot lock " + lockFile);
+    return fd;
+}
+
+static bool file_exists (const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("accumulator,a", po::value<std::string>()->required(), "Aggregate file holding the running encrypted sum and count.")
+            ("cipherText,c", po::value<std::vector<std::string>>(), "File containing a ciphertext to fold in (repeatable, also positional).")
+            ("column,C", po::value<std::vector<std::string>>(), "File containing a ciphertext column to fold in (repeatable).")
+            ("squares,q", "Also keep the encrypted sum of squares when creating a new accumulator.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads.");
+
+        po::positional_options_description positional;
+        positional.add("cipherText", -1);
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).positional(positional).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        std::string accFile = vm["accumulator"].as<std::string>();
+        int lock = lock_accumulator(accFile);
+
+        encrypted_aggregate acc;
+        aggregate_init(acc, vm.count("squares") > 0);
+        if (file_exists(accFile))
+            aggregate_from_json(read_json(accFile), acc);
+        if (!acc.Key.empty() && acc.Key != key_fingerprint(N))
+            throw std::runtime_error(accFile + " was computed under another key");
+        acc.Key = key_fingerprint(N);
+
+        // fold the new ciphertexts into per-worker partials
+        pipeline_options opt = default_pipeline_options(vm["threads"].as<unsigned>());
+        std::vector<encrypted_aggregate> partial(opt.Threads);
+        for (auto &a : partial)
+            aggregate_init(a, acc.HasSumOfSquares);
+
+        if (vm.count("cipherText"))
+        {
+            column_batch files;
+            for (const auto &file : vm["cipherText"].as<std::vector<std::string>>())
+            {
+                mpz_rational x;
+                rational_init(x);
+                files.push_back(x);
+                read_ciphertext(file, files[files.size() - 1]);
+            }
+            aggregate_fold(partial[0], files.begin(), files.end(), N);
+        }
+        if (vm.count("column"))
+        {
+            column_source source(vm["column"].as<std::vector<std::string>>(), opt.BatchSize);
+            run_pipeline<column_batch>(opt, source, [&](unsigned w, column_batch &batch)
+            {
+                aggregate_fold(partial[w], batch.begin(), batch.end(), N);
+            });
+        }
+
+        for (auto &a : partial)
+            aggregate_merge(acc, a, N);
+
+        write_json_atomic(accFile, aggregate_to_json(acc));
+        close(lock);
+
+        // cleanup
+        for (auto &a : partial)
+            aggregate_clear(a);
+        aggregate_clear(acc);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
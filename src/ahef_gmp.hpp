@@ -0,0 +1,678 @@
+/*
+ *  Shared GMP helpers for the ahefutil tools.
+ *
+ *  Ciphertexts are rationals c = a/b with a and b reduced into (-N, N) by smod.
+ *  A single ciphertext is stored as a JSON file with HEX "numerator" and
+ *  "denominator" (see encrypt.cpp). A ciphertext column is a plain text file
+ *  with one ciphertext per line:
+ *
+ *      <numerator HEX> <denominator HEX>
+ *
+ *  Empty lines and lines starting with '#' are ignored. A keyed column puts a
+ *  plaintext key (no whitespace) in front of every ciphertext:
+ *
+ *      <key> <numerator HEX> <denominator HEX>
+ *
+ *  An aggregate file is a JSON object holding a plaintext count and encrypted
+ *  sums (see statenc.cpp and accenc.cpp):
+ *
+ *      { "count": n, "sum": {...}, "sumOfSquares": {...}, "key": ..., "shard": "i/n", "created": ... }
+ *
+ *  where "sumOfSquares" is optional, "key" is the fingerprint of the public key
+ *  the sums were computed under (aggregates of different keys never merge) and
+ *  "shard" marks a partial aggregate of slice i of n (see statenc --shard and
+ *  mergeagg).
+ *
+ *  An encrypted matrix is a ciphertext column in row-major order preceded by
+ *  the comment line "#matrix <rows> <cols>", so it is also a valid column.
+ *
+ *  A packed plaintext holds k signed integer lanes of laneBits bits each,
+ *  x = v_0 + v_1*2^laneBits + ... + v_(k-1)*2^((k-1)*laneBits), with
+ *  denominator 1. Homomorphic add/sub and multiplication by a plaintext
+ *  integer act on every lane independently as long as each lane stays in
+ *  [-2^(laneBits-1), 2^(laneBits-1)) and k*laneBits < bits(p) - 1; ciphertext
+ *  by ciphertext multiplication does not (it convolves the lanes).
+ */
+
+#ifndef AHEF_GMP_HPP
+#define AHEF_GMP_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+#include <gcrypt.h>
+#include <gmp.h>
+
+
+struct mpz_rational
+{
+    mpz_t Numerator;
+    mpz_t Denominator;
+};
+
+
+// reduce a into (-p, p) keeping its sign
+inline void smod (mpz_t a, const mpz_t p)
+{
+    if (mpz_sgn(a) < 0)
+    {
+        mpz_abs(a,a);
+        mpz_mod(a, a, p);
+        mpz_neg(a, a);
+    }
+    else
+    {
+        mpz_mod(a, a, p);
+    }
+}
+
+// reduce a into (-p/2, p/2], the signed value of a mod p
+inline void balanced_mod (mpz_t a, const mpz_t p)
+{
+    mpz_mod(a, a, p);
+    mpz_t half;
+    mpz_init(half);
+    mpz_fdiv_q_2exp(half, p, 1);
+    if (mpz_cmp(a, half) > 0)
+        mpz_sub(a, a, p);
+    mpz_clear(half);
+}
+
+inline void rational_init (mpz_rational &r)
+{
+    mpz_init(r.Numerator);
+    mpz_init(r.Denominator);
+}
+
+// E(0) = 0/1 is the neutral element of the homomorphic addition
+inline void rational_init_zero (mpz_rational &r)
+{
+    mpz_init_set_ui(r.Numerator, 0);
+    mpz_init_set_ui(r.Denominator, 1);
+}
+
+// E(1) = 1/1 is the neutral element of the homomorphic multiplication
+inline void rational_init_one (mpz_rational &r)
+{
+    mpz_init_set_ui(r.Numerator, 1);
+    mpz_init_set_ui(r.Denominator, 1);
+}
+
+inline void rational_clear (mpz_rational &r)
+{
+    mpz_clear(r.Numerator);
+    mpz_clear(r.Denominator);
+}
+
+inline void rational_set (mpz_rational &r, const mpz_rational &x)
+{
+    mpz_set(r.Numerator, x.Numerator);
+    mpz_set(r.Denominator, x.Denominator);
+}
+
+inline void clear_column (std::vector<mpz_rational> &column)
+{
+    for (auto &c : column)
+        rational_clear(c);
+    column.clear();
+}
+
+
+// add encrypted numbers: E(x+y) = smod( (a1*b2 + a2*b1) / (b1*b2), N); r may alias x or y
+inline void add_rational (mpz_rational &r, const mpz_rational &x, const mpz_rational &y, const mpz_t N)
+{
+    mpz_t t1, t2;
+    mpz_init (t1);
+    mpz_init (t2);
+
+    mpz_mul(t1, x.Numerator, y.Denominator);
+    mpz_mul(t2, y.Numerator, x.Denominator);
+    mpz_add(t1, t1, t2);
+    mpz_mul(r.Denominator, x.Denominator, y.Denominator);
+    mpz_swap(r.Numerator, t1);
+    smod(r.Numerator, N);
+    smod(r.Denominator, N);
+
+    mpz_clear (t1);
+    mpz_clear (t2);
+}
+
+// subtract encrypted numbers: E(x-y) = smod( (a1*b2 - a2*b1) / (b1*b2), N); r may alias x or y
+inline void sub_rational (mpz_rational &r, const mpz_rational &x, const mpz_rational &y, const mpz_t N)
+{
+    mpz_t t1, t2;
+    mpz_init (t1);
+    mpz_init (t2);
+
+    mpz_mul(t1, x.Numerator, y.Denominator);
+    mpz_mul(t2, y.Numerator, x.Denominator);
+    mpz_sub(t1, t1, t2);
+    mpz_mul(r.Denominator, x.Denominator, y.Denominator);
+    mpz_swap(r.Numerator, t1);
+    smod(r.Numerator, N);
+    smod(r.Denominator, N);
+
+    mpz_clear (t1);
+    mpz_clear (t2);
+}
+
+// multiply encrypted numbers: E(x*y) = smod( (a1*a2) / (b1*b2), N); r may alias x or y
+inline void mul_rational (mpz_rational &r, const mpz_rational &x, const mpz_rational &y, const mpz_t N)
+{
+    mpz_mul(r.Numerator, x.Numerator, y.Numerator);
+    smod(r.Numerator, N);
+
+    mpz_mul(r.Denominator, x.Denominator, y.Denominator);
+    smod(r.Denominator, N);
+}
+
+// fused multiply-add: E(x*y + z) = smod( (a1*a2*b3 + a3*b1*b2) / (b1*b2*b3), N). The
+// products stay unreduced, so there is one reduction per component instead of the
+// two of mul_rational plus the two of add_rational; r may alias x, y or z
+inline void fma_rational (mpz_rational &r, const mpz_rational &x, const mpz_rational &y, const mpz_rational &z,
+                          const mpz_t N)
+{
+    mpz_t t1, t2;
+    mpz_init (t1);
+    mpz_init (t2);
+
+    mpz_mul(t1, x.Numerator, y.Numerator);
+    mpz_mul(t1, t1, z.Denominator);
+    mpz_mul(t2, x.Denominator, y.Denominator);
+    mpz_addmul(t1, z.Numerator, t2);
+    mpz_mul(r.Denominator, t2, z.Denominator);
+    mpz_swap(r.Numerator, t1);
+    smod(r.Numerator, N);
+    smod(r.Denominator, N);
+
+    mpz_clear (t1);
+    mpz_clear (t2);
+}
+
+
+// get fractional approximation value = numerator/denominator with denominator > 0
+inline void rational_from_double (mpz_t numerator, mpz_t denominator, double value)
+{
+    mpf_t V;
+    mpf_init2(V, 1024);
+    mpf_set_d(V, value);
+
+    mpq_t fractional;
+    mpq_init (fractional);
+    mpq_set_f(fractional, V);
+    mpq_canonicalize(fractional);
+    mpq_get_num(numerator, fractional);
+    mpq_get_den(denominator, fractional);
+
+    mpq_clear(fractional);
+    mpf_clear(V);
+}
+
+// largest lane count with k*laneBits < bits(p) - 1, so that |x| < p/2
+inline size_t max_lanes (const mpz_t p, unsigned laneBits)
+{
+    return (mpz_sizeinbase(p, 2) - 2) / laneBits;
+}
+
+// r = sum of v[i] * 2^(i*laneBits); throws if a value does not fit its lane
+inline void pack_lanes (mpz_t r, const long long *v, size_t lanes, unsigned laneBits)
+{
+    mpz_t t, bound;
+    mpz_init(t);
+    mpz_init(bound);
+    mpz_setbit(bound, laneBits - 1);
+    mpz_set_ui(r, 0);
+    for (size_t i = lanes; i-- > 0; )
+    {
+        mpz_set_si(t, v[i]);
+        if (mpz_cmp(t, bound) >= 0 || mpz_cmpabs(t, bound) > 0)
+        {
+            mpz_clear(t);
+            mpz_clear(bound);
+            throw std::runtime_error("value " + std::to_string(v[i]) + " does not fit a " + std::to_string(laneBits) + "-bit lane");
+        }
+        mpz_mul_2exp(r, r, laneBits);
+        mpz_add(r, r, t);
+    }
+    mpz_clear(t);
+    mpz_clear(bound);
+}
+
+// split x (mod p, any representative) into `lanes` signed lanes, decimal
+inline std::vector<std::string> unpack_lanes (const mpz_t x, const mpz_t p, size_t lanes, unsigned laneBits)
+{
+    mpz_t r, half, v;
+    mpz_init(r);
+    mpz_init(half);
+    mpz_init(v);
+
+    mpz_set(r, x);
+    balanced_mod(r, p);
+
+    // signed digits: v = r mod 2^laneBits in [-2^(laneBits-1), 2^(laneBits-1))
+    std::vector<std::string> out;
+    for (size_t i = 0; i < lanes; ++i)
+    {
+        mpz_fdiv_r_2exp(v, r, laneBits);
+        if (mpz_tstbit(v, laneBits - 1))
+        {
+            mpz_set_ui(half, 0);
+            mpz_setbit(half, laneBits);
+            mpz_sub(v, v, half);
+        }
+        mpz_sub(r, r, v);
+        mpz_fdiv_q_2exp(r, r, laneBits);
+
+        char *str = mpz_get_str(NULL, 10, v);
+        out.push_back(str);
+        void (*freefunc)(void *, size_t);
+        mp_get_memory_functions(NULL, NULL, &freefunc);
+        freefunc(str, strlen(str) + 1);
+    }
+
+    mpz_clear(r);
+    mpz_clear(half);
+    mpz_clear(v);
+    return out;
+}
+
+
+inline std::string to_hex (const mpz_t a)
+{
+    char *buf;
+    gmp_asprintf (&buf, "%Zx", a);
+    std::string s(buf);
+
+    void (*freefunc)(void *, size_t);
+    mp_get_memory_functions (NULL, NULL, &freefunc);
+    freefunc (buf, s.size() + 1);
+    return s;
+}
+
+inline void set_hex (mpz_t a, const std::string &s)
+{
+    if (mpz_set_str (a, s.c_str(), 16) != 0)
+        throw std::runtime_error("invalid HEX number: " + s);
+}
+
+inline std::string created_now ()
+{
+    time_t t;
+    time(&t);
+    return ctime(&t);
+}
+
+
+inline nlohmann::json read_json (const std::string &path)
+{
+    nlohmann::json j;
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error("cannot open " + path);
+    ifs >> j;
+    ifs.close();
+    return j;
+}
+
+inline void write_json (const std::string &path, const nlohmann::json &j)
+{
+    std::ofstream ofs (path, std::ofstream::out);
+    if (!ofs)
+        throw std::runtime_error("cannot write " + path);
+    ofs << std::setw(4) << j << std::endl;
+    ofs.close();
+}
+
+// write j to a temporary file, fsync it and rename(2) it over path, so that
+// readers and crashes only ever observe either the old or the new content
+inline void write_json_atomic (const std::string &path, const nlohmann::json &j)
+{
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+    std::string data = j.dump(4) + "\n";
+
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot write " + tmp);
+    for (size_t done = 0; done < data.size(); )
+    {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0)
+        {
+            close(fd);
+            unlink(tmp.c_str());
+            throw std::runtime_error("cannot write " + tmp);
+        }
+        done += n;
+    }
+    if (fsync(fd) != 0 || close(fd) != 0 || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        unlink(tmp.c_str());
+        throw std::runtime_error("cannot replace " + path);
+    }
+
+    // persist the directory entry of the rename
+    size_t slash = path.find_last_of('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int dfd = open(dir.c_str(), O_RDONLY);
+    if (dfd >= 0)
+    {
+        fsync(dfd);
+        close(dfd);
+    }
+}
+
+// read N from a public key file written by extract
+inline void read_public_key (const std::string &path, mpz_t N)
+{
+    nlohmann::json public_key = read_json(path);
+    set_hex(N, public_key["N"].get<std::string>());
+}
+
+// lowercase HEX SHA-256 of data
+inline std::string sha256_hex (const std::string &data)
+{
+    gcry_check_version(NULL);
+    unsigned char digest[32];
+    gcry_md_hash_buffer(GCRY_MD_SHA256, digest, data.data(), data.size());
+
+    std::ostringstream hex;
+    for (unsigned char b : digest)
+        hex << std::hex << std::setw(2) << std::setfill('0') << unsigned(b);
+    return hex.str();
+}
+
+// identifies the public key N in aggregate files
+inline std::string key_fingerprint (const mpz_t N)
+{
+    return sha256_hex(to_hex(N)).substr(0, 32);
+}
+
+inline void ciphertext_from_json (const nlohmann::json &j, mpz_rational &r)
+{
+    set_hex(r.Numerator, j["numerator"].get<std::string>());
+    set_hex(r.Denominator, j["denominator"].get<std::string>());
+}
+
+inline nlohmann::json ciphertext_to_json (const mpz_rational &r)
+{
+    nlohmann::json j;
+    j["numerator"] = to_hex(r.Numerator);
+    j["denominator"] = to_hex(r.Denominator);
+    return j;
+}
+
+inline void read_ciphertext (const std::string &path, mpz_rational &r)
+{
+    ciphertext_from_json(read_json(path), r);
+}
+
+inline void write_ciphertext (const std::string &path, const mpz_rational &r)
+{
+    nlohmann::json j = ciphertext_to_json(r);
+    j["created"] = created_now();
+    write_json(path, j);
+}
+
+
+struct encrypted_aggregate
+{
+    unsigned long Count;
+    bool HasSumOfSquares;
+    mpz_rational Sum;
+    mpz_rational SumOfSquares;
+    std::string Key;        // key_fingerprint, empty when unknown
+    std::string Shard;      // "i/n" for a partial aggregate, else empty
+};
+
+// initialize an empty aggregate: count 0, E(Σx) = E(Σx²) = E(0)
+inline void aggregate_init (encrypted_aggregate &a, bool squares)
+{
+    a.Count = 0;
+    a.HasSumOfSquares = squares;
+    a.Key.clear();
+    a.Shard.clear();
+    rational_init_zero(a.Sum);
+    rational_init_zero(a.SumOfSquares);
+}
+
+inline void aggregate_clear (encrypted_aggregate &a)
+{
+    rational_clear(a.Sum);
+    rational_clear(a.SumOfSquares);
+}
+
+// fold the ciphertexts [first, last) into a; each ciphertext is loaded once
+// and feeds both E(Σx) and E(Σx²)
+inline void aggregate_fold (encrypted_aggregate &a, const mpz_rational *first, const mpz_rational *last, const mpz_t N)
+{
+    mpz_t sq_n, sq_d, t;
+    mpz_init (sq_n);
+    mpz_init (sq_d);
+    mpz_init (t);
+
+    for (const mpz_rational *x = first; x != last; ++x)
+    {
+        // E(Σx) += E(x)
+        mpz_mul(t, a.Sum.Numerator, x->Denominator);
+        mpz_addmul(t, x->Numerator, a.Sum.Denominator);
+        mpz_swap(a.Sum.Numerator, t);
+        smod(a.Sum.Numerator, N);
+        mpz_mul(a.Sum.Denominator, a.Sum.Denominator, x->Denominator);
+        smod(a.Sum.Denominator, N);
+
+        if (!a.HasSumOfSquares)
+            continue;
+
+        // E(x²) = smod( a² / b², N)
+        mpz_mul(sq_n, x->Numerator, x->Numerator);
+        smod(sq_n, N);
+        mpz_mul(sq_d, x->Denominator, x->Denominator);
+        smod(sq_d, N);
+
+        // E(Σx²) += E(x²)
+        mpz_mul(t, a.SumOfSquares.Numerator, sq_d);
+        mpz_addmul(t, sq_n, a.SumOfSquares.Denominator);
+        mpz_swap(a.SumOfSquares.Numerator, t);
+        smod(a.SumOfSquares.Numerator, N);
+        mpz_mul(a.SumOfSquares.Denominator, a.SumOfSquares.Denominator, sq_d);
+        smod(a.SumOfSquares.Denominator, N);
+    }
+    a.Count += last - first;
+
+    mpz_clear (sq_n);
+    mpz_clear (sq_d);
+    mpz_clear (t);
+}
+
+// a += b
+inline void aggregate_merge (encrypted_aggregate &a, const encrypted_aggregate &b, const mpz_t N)
+{
+    if (a.HasSumOfSquares && !b.HasSumOfSquares)
+        throw std::runtime_error("cannot merge an aggregate without sumOfSquares");
+    if (!a.Key.empty() && !b.Key.empty() && a.Key != b.Key)
+        throw std::runtime_error("cannot merge aggregates computed under different keys");
+    if (a.Key.empty())
+        a.Key = b.Key;
+
+    add_rational(a.Sum, a.Sum, b.Sum, N);
+    if (a.HasSumOfSquares)
+        add_rational(a.SumOfSquares, a.SumOfSquares, b.SumOfSquares, N);
+    a.Count += b.Count;
+}
+
+inline nlohmann::json aggregate_to_json (const encrypted_aggregate &a)
+{
+    nlohmann::json j;
+    j["count"] = a.Count;
+    j["sum"] = ciphertext_to_json(a.Sum);
+    if (a.HasSumOfSquares)
+        j["sumOfSquares"] = ciphertext_to_json(a.SumOfSquares);
+    if (!a.Key.empty())
+        j["key"] = a.Key;
+    if (!a.Shard.empty())
+        j["shard"] = a.Shard;
+    j["created"] = created_now();
+    return j;
+}
+
+// a must have been initialized with aggregate_init
+inline void aggregate_from_json (const nlohmann::json &j, encrypted_aggregate &a)
+{
+    a.Count = j["count"].get<unsigned long>();
+    ciphertext_from_json(j["sum"], a.Sum);
+    a.HasSumOfSquares = j.count("sumOfSquares") > 0;
+    if (a.HasSumOfSquares)
+        ciphertext_from_json(j["sumOfSquares"], a.SumOfSquares);
+    a.Key = j.count("key") ? j["key"].get<std::string>() : "";
+    a.Shard = j.count("shard") ? j["shard"].get<std::string>() : "";
+}
+
+// "i/n" with 0 <= i < n, as in the "shard" of a partial aggregate
+inline void parse_shard (const std::string &s, size_t &i, size_t &n)
+{
+    size_t slash = s.find('/');
+    try
+    {
+        if (slash == std::string::npos)
+            throw std::invalid_argument(s);
+        i = std::stoul(s.substr(0, slash));
+        n = std::stoul(s.substr(slash + 1));
+    }
+    catch (std::logic_error &)
+    {
+        throw std::runtime_error("invalid shard \"" + s + "\", expected i/n");
+    }
+    if (n == 0 || i >= n)
+        throw std::runtime_error("invalid shard \"" + s + "\", expected 0 <= i < n");
+}
+
+
+// parse one column line into r; returns false for empty and comment lines
+inline bool parse_column_line (const std::string &line, mpz_rational &r)
+{
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos || line[begin] == '#')
+        return false;
+
+    size_t sep = line.find_first_of(" \t", begin);
+    size_t second = (sep == std::string::npos) ? sep : line.find_first_not_of(" \t", sep);
+    if (second == std::string::npos)
+        throw std::runtime_error("malformed ciphertext column line: " + line);
+    size_t end = line.find_first_of(" \t\r", second);
+
+    set_hex(r.Numerator, line.substr(begin, sep - begin));
+    set_hex(r.Denominator, line.substr(second, end == std::string::npos ? end : end - second));
+    return true;
+}
+
+inline std::string format_column_line (const mpz_rational &r)
+{
+    return to_hex(r.Numerator) + " " + to_hex(r.Denominator);
+}
+
+// parse one keyed column line into key and r; returns false for empty and comment lines
+inline bool parse_keyed_column_line (const std::string &line, std::string &key, mpz_rational &r)
+{
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos || line[begin] == '#')
+        return false;
+
+    size_t sep = line.find_first_of(" \t", begin);
+    if (sep == std::string::npos)
+        throw std::runtime_error("malformed keyed column line: " + line);
+    key.assign(line, begin, sep - begin);
+    if (!parse_column_line(line.substr(sep), r))
+        throw std::runtime_error("malformed keyed column line: " + line);
+    return true;
+}
+
+inline std::string format_keyed_column_line (const std::string &key, const mpz_rational &r)
+{
+    return key + " " + format_column_line(r);
+}
+
+// append all ciphertexts of a column file to column
+inline void read_column (const std::string &path, std::vector<mpz_rational> &column)
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error("cannot open " + path);
+
+    std::string line;
+    mpz_rational r;
+    rational_init(r);
+    while (std::getline(ifs, line))
+    {
+        if (!parse_column_line(line, r))
+            continue;
+        column.push_back(r);
+        rational_init(r);
+    }
+    rational_clear(r);
+}
+
+inline void write_column (const std::string &path, const std::vector<mpz_rational> &column)
+{
+    std::ofstream ofs (path, std::ofstream::out);
+    if (!ofs)
+        throw std::runtime_error("cannot write " + path);
+    for (const auto &c : column)
+        ofs << format_column_line(c) << '\n';
+    ofs.close();
+}
+
+
+// rows x cols ciphertexts, row-major
+struct encrypted_matrix
+{
+    size_t Rows, Cols;
+    std::vector<mpz_rational> Elements;
+
+    mpz_rational &operator() (size_t i, size_t j) { return Elements[i * Cols + j]; }
+    const mpz_rational &operator() (size_t i, size_t j) const { return Elements[i * Cols + j]; }
+};
+
+inline void read_matrix (const std::string &path, encrypted_matrix &m)
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error("cannot open " + path);
+    std::string line;
+    while (std::getline(ifs, line) && line.find_first_not_of(" \t\r") == std::string::npos)
+        ;
+    std::istringstream header(line);
+    std::string tag;
+    if (!(header >> tag >> m.Rows >> m.Cols) || tag != "#matrix")
+        throw std::runtime_error("missing \"#matrix <rows> <cols>\" header in " + path);
+    ifs.close();
+
+    read_column(path, m.Elements);
+    if (m.Elements.size() != m.Rows * m.Cols)
+        throw std::runtime_error(path + " holds " + std::to_string(m.Elements.size()) + " ciphertexts, expected " +
+                                 std::to_string(m.Rows) + "x" + std::to_string(m.Cols));
+}
+
+inline void write_matrix (const std::string &path, const encrypted_matrix &m)
+{
+    std::ofstream ofs (path, std::ofstream::out);
+    if (!ofs)
+        throw std::runtime_error("cannot write " + path);
+    ofs << "#matrix " << m.Rows << " " << m.Cols << '\n';
+    for (const auto &c : m.Elements)
+        ofs << format_column_line(c) << '\n';
+    ofs.close();
+}
+
+#endif // AHEF_GMP_HPP
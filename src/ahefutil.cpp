@@ -0,0 +1,116 @@
+/*
+ *  ahefutil <tool> [options]
+ *  ln -s ahefutil decrypt && ./decrypt [options]
+ *
+ *  Multi-call binary holding every tool of the suite, busybox style. The tool
+ *  is taken from the name the binary was invoked under (a symlink named after
+ *  the tool) or else from the first argument. Each tool source is compiled
+ *  with -DAHEF_MULTICALL -Dmain=ahef_<tool>_main (make ahefutil), so the
+ *  sources stay unchanged and still build as separate binaries.
+ *
+ *  One process image replaces the separately linked binaries: the shared
+ *  libraries are loaded and relocated once per binary rather than per tool
+ *  on disk, and with make ahefutil STATIC=1 not at all. Library state is set
+ *  up lazily by the tool that runs: gcrypt is initialized only by the tools
+ *  that use it (genpkey, extract, encrypt) and only after their options
+ *  parsed, the GMP tools (decrypt among them) never touch it.
+ *
+ *  ahefutil eval runs evalenc, the expression evaluator. ahefutil --list
+ *  prints the tool names, one per line (make ahefutil-links).
+ */
+
+#include <string.h>
+#include <iostream>
+#include <string>
+
+#ifndef AHEF_MULTICALL
+#error "build with make ahefutil"
+#endif
+
+// every tool in the binary, in Makefile order
+#define AHEF_TOOLS(X) \
+    X(genpkey) X(extract) X(encrypt) X(decrypt) X(addenc) X(subenc) X(mulenc) \
+    X(statenc) X(scalenc) X(powenc) X(accenc) X(dirsum) X(prodenc) X(matenc) \
+    X(groupenc) X(rollenc) X(scanenc) X(rangeenc) X(mergeagg) X(dagenc) X(fmaenc) X(evalenc) \
+    X(arrowenc)
+
+#define AHEF_DECLARE(tool) int ahef_##tool##_main (int argc, char** argv);
+AHEF_TOOLS(AHEF_DECLARE)
+#undef AHEF_DECLARE
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+
+  struct tool_entry
+  {
+      const char *Name;
+      int (*Main) (int argc, char** argv);
+  };
+
+#define AHEF_ENTRY(tool) { #tool, ahef_##tool##_main },
+  const tool_entry tools[] = { AHEF_TOOLS(AHEF_ENTRY) };
+#undef AHEF_ENTRY
+
+  // subcommand names that are not tools of their own (no symlink, as eval is
+  // a shell builtin)
+  const tool_entry aliases[] = { { "eval", ahef_evalenc_main } };
+
+} // namespace
+
+
+static const tool_entry *find_tool (const char *name, bool withAliases)
+{
+    for (const tool_entry &tool : tools)
+        if (strcmp(tool.Name, name) == 0)
+            return &tool;
+    if (withAliases)
+        for (const tool_entry &alias : aliases)
+            if (strcmp(alias.Name, name) == 0)
+                return &alias;
+    return nullptr;
+}
+
+
+static void usage (std::ostream &os)
+{
+    os << "Usage: ahefutil <tool> [options]" << std::endl
+       << "       <tool> [options]   (symlink to ahefutil)" << std::endl
+       << "       ahefutil <tool> --help" << std::endl << std::endl
+       << "Tools:";
+    for (const tool_entry &tool : tools)
+        os << " " << tool.Name;
+    for (const tool_entry &alias : aliases)
+        os << " " << alias.Name;
+    os << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    // dispatch on the invoked name first, so symlinks behave like the old binaries
+    const char *invoked = strrchr(argv[0], '/');
+    invoked = invoked ? invoked + 1 : argv[0];
+    if (const tool_entry *tool = find_tool(invoked, false))
+        return tool->Main(argc, argv);
+
+    if (argc < 2 || strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0)
+    {
+        usage(std::cout);
+        return argc < 2 ? ERROR_IN_COMMAND_LINE : 0;
+    }
+
+    if (strcmp(argv[1], "--list") == 0)
+    {
+        for (const tool_entry &tool : tools)
+            std::cout << tool.Name << std::endl;
+        return 0;
+    }
+
+    if (const tool_entry *tool = find_tool(argv[1], true))
+        return tool->Main(argc - 1, argv + 1);
+
+    std::cerr << "ERROR: unknown tool '" << argv[1] << "'" << std::endl << std::endl;
+    usage(std::cerr);
+    return ERROR_IN_COMMAND_LINE;
+}
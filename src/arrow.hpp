@@ -0,0 +1,706 @@
+/*
+ *  Ciphertext columns in the Apache Arrow IPC file format, written and read
+ *  without the Arrow libraries.
+ *
+ *  A file holds one ciphertext column as two non-nullable FixedSizeBinary
+ *  fields "numerator" and "denominator", preceded by a Utf8 field "key" for
+ *  keyed columns. Every value is the little-endian two's complement of the
+ *  signed integer in byteWidth = 8 * (limbs of N + 1) bytes, so |value| < N
+ *  always fits. The schema metadata records the encoding ("ahef.encoding")
+ *  and the key fingerprint ("ahef.key", see key_fingerprint).
+ *
+ *  Layout (format version V5): "ARROW1" magic, the schema message, one record
+ *  batch message per batch of rows, the end-of-stream marker, the footer with
+ *  the schema and the position of every record batch, its length and the magic
+ *  again. The metadata is padded so that every body starts on a 64-byte file
+ *  offset and every buffer in it is 64-byte aligned, which lets a reader mmap
+ *  the file and use the value arrays in place (arrow_column_reader).
+ *
+ *  The metadata is FlatBuffers-encoded; flatbuffer_builder and flatbuffer_view
+ *  implement the part of FlatBuffers the Arrow schema needs: tables, unions,
+ *  strings and vectors of tables and of structs.
+ */
+
+#ifndef AHEF_ARROW_HPP
+#define AHEF_ARROW_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ahef_gmp.hpp"
+
+
+// builds a flatbuffer front to back: a table is written before the objects it
+// references, which are appended after it and linked by patching the offsets
+class flatbuffer_builder
+{
+public:
+    // writes an object and returns its position
+    typedef std::function<size_t (flatbuffer_builder &)> object;
+
+    class table
+    {
+    public:
+        template <typename T>
+        table &scalar (int slot, T value)
+        {
+            field f;
+            f.Slot = slot;
+            f.Size = sizeof(T);
+            f.Bits = 0;
+            memcpy(&f.Bits, &value, sizeof(T));
+            fields_.push_back(f);
+            return *this;
+        }
+
+        table &ref (int slot, object child)
+        {
+            field f;
+            f.Slot = slot;
+            f.Size = 4;
+            f.Bits = 0;
+            f.Child = child;
+            fields_.push_back(f);
+            return *this;
+        }
+
+    private:
+        friend class flatbuffer_builder;
+        struct field
+        {
+            int Slot;
+            size_t Size;
+            uint64_t Bits;
+            object Child;
+        };
+        std::vector<field> fields_;
+    };
+
+    // a buffer with root at its start, padded to 8 bytes
+    static std::string finish (const table &root)
+    {
+        flatbuffer_builder b;
+        b.put<uint32_t>(0);
+        b.patch(0, b.write(root));
+        b.align(8);
+        return b.buf_;
+    }
+
+    size_t write (const table &t)
+    {
+        int slots = 0;
+        for (const auto &f : t.fields_)
+            slots = std::max(slots, f.Slot + 1);
+
+        align(2);
+        size_t vtable = position();
+        for (int i = 0; i < 2 + slots; ++i)
+            put<uint16_t>(0);
+
+        // the table: offset to its vtable, then the fields by falling size, so
+        // that with start + 4 on 8 bytes every field is naturally aligned
+        align(4);
+        if ((position() + 4) % 8)
+            put<uint32_t>(0);
+        size_t start = position();
+        put<int32_t>(int32_t(start - vtable));
+
+        std::vector<size_t> at(t.fields_.size());
+        for (size_t size = 8; size > 0; size /= 2)
+        {
+            for (size_t k = 0; k < t.fields_.size(); ++k)
+            {
+                if (t.fields_[k].Size != size)
+                    continue;
+                at[k] = position();
+                buf_.append(reinterpret_cast<const char *>(&t.fields_[k].Bits), size);
+                set<uint16_t>(vtable + 4 + 2 * t.fields_[k].Slot, uint16_t(at[k] - start));
+            }
+        }
+        set<uint16_t>(vtable, uint16_t(4 + 2 * slots));
+        set<uint16_t>(vtable + 2, uint16_t(position() - start));
+
+        for (size_t k = 0; k < t.fields_.size(); ++k)
+            if (t.fields_[k].Child)
+                patch(at[k], t.fields_[k].Child(*this));
+        return start;
+    }
+
+    size_t write_string (const std::string &s)
+    {
+        align(4);
+        size_t pos = position();
+        put<uint32_t>(uint32_t(s.size()));
+        buf_.append(s);
+        buf_.push_back('\0');
+        return pos;
+    }
+
+    size_t write_tables (const std::vector<table> &tables)
+    {
+        align(4);
+        size_t pos = position();
+        put<uint32_t>(uint32_t(tables.size()));
+        for (size_t k = 0; k < tables.size(); ++k)
+            put<uint32_t>(0);
+        for (size_t k = 0; k < tables.size(); ++k)
+            patch(pos + 4 + 4 * k, write(tables[k]));
+        return pos;
+    }
+
+    // count structs of size bytes each, 8-byte aligned
+    size_t write_structs (const void *data, size_t count, size_t size)
+    {
+        align(4);
+        if ((position() + 4) % 8)
+            put<uint32_t>(0);
+        size_t pos = position();
+        put<uint32_t>(uint32_t(count));
+        if (count)
+            buf_.append(static_cast<const char *>(data), count * size);
+        return pos;
+    }
+
+private:
+    size_t position () const { return buf_.size(); }
+
+    void align (size_t n)
+    {
+        buf_.append((n - buf_.size() % n) % n, '\0');
+    }
+
+    template <typename T>
+    void put (T value)
+    {
+        buf_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void set (size_t at, T value)
+    {
+        memcpy(&buf_[at], &value, sizeof(T));
+    }
+
+    // offsets point forward, relative to where they are stored
+    void patch (size_t at, size_t target)
+    {
+        set<uint32_t>(at, uint32_t(target - at));
+    }
+
+    std::string buf_;
+};
+
+
+// bounds-checked access to a flatbuffer; positions are byte offsets, 0 means absent
+class flatbuffer_view
+{
+public:
+    flatbuffer_view (const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    size_t root () const { return deref(0); }
+
+    size_t field (size_t table, int slot) const
+    {
+        if (!table)
+            throw std::runtime_error("corrupt flatbuffer: missing table");
+        int64_t vtable = int64_t(table) - read<int32_t>(table);
+        if (vtable < 0)
+            throw std::runtime_error("corrupt flatbuffer");
+        uint16_t vsize = read<uint16_t>(size_t(vtable));
+        if (size_t(4 + 2 * slot) >= vsize)
+            return 0;
+        uint16_t offset = read<uint16_t>(size_t(vtable) + 4 + 2 * slot);
+        return offset ? table + offset : 0;
+    }
+
+    template <typename T>
+    T scalar (size_t table, int slot, T fallback) const
+    {
+        size_t f = field(table, slot);
+        return f ? read<T>(f) : fallback;
+    }
+
+    size_t ref (size_t table, int slot) const
+    {
+        size_t f = field(table, slot);
+        return f ? deref(f) : 0;
+    }
+
+    size_t deref (size_t at) const { return at + read<uint32_t>(at); }
+
+    // a vector: its length, the position of element k of size bytes, the table element k
+    size_t length (size_t vec) const { return vec ? read<uint32_t>(vec) : 0; }
+    size_t element (size_t vec, size_t k, size_t size) const { return vec + 4 + k * size; }
+    size_t table_at (size_t vec, size_t k) const { return deref(element(vec, k, 4)); }
+
+    std::string string (size_t s) const
+    {
+        if (!s)
+            return "";
+        size_t n = read<uint32_t>(s);
+        if (s + 4 + n > size_)
+            throw std::runtime_error("corrupt flatbuffer");
+        return std::string(reinterpret_cast<const char *>(data_ + s + 4), n);
+    }
+
+    template <typename T>
+    T read (size_t at) const
+    {
+        if (at + sizeof(T) > size_)
+            throw std::runtime_error("corrupt flatbuffer");
+        T value;
+        memcpy(&value, data_ + at, sizeof(T));
+        return value;
+    }
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+};
+
+
+const int16_t ARROW_METADATA_V5 = 4;
+const uint8_t ARROW_HEADER_SCHEMA = 1;
+const uint8_t ARROW_HEADER_RECORD_BATCH = 3;
+const uint8_t ARROW_TYPE_UTF8 = 5;
+const uint8_t ARROW_TYPE_FIXED_SIZE_BINARY = 15;
+const size_t ARROW_ALIGNMENT = 64;
+const char ARROW_MAGIC[] = "ARROW1";
+const char ARROW_ENCODING[] = "int-le-twos-complement";
+
+// FieldNode, Buffer and Block of the Arrow schema (structs, little-endian)
+struct arrow_field_node
+{
+    int64_t Length;
+    int64_t NullCount;
+};
+
+struct arrow_buffer
+{
+    int64_t Offset;
+    int64_t Length;
+};
+
+struct arrow_block
+{
+    int64_t Offset;
+    int32_t MetaDataLength;
+    int32_t Padding;
+    int64_t BodyLength;
+};
+
+// bytes per value for ciphertexts under N
+inline size_t arrow_byte_width (const mpz_t N)
+{
+    return 8 * (mpz_size(N) + 1);
+}
+
+// v as width bytes of little-endian two's complement; t is scratch
+inline void encode_twos_complement (uint8_t *out, size_t width, const mpz_t v, mpz_t t)
+{
+    if (mpz_sizeinbase(v, 2) >= 8 * width)
+        throw std::runtime_error("ciphertext does not fit the column width");
+
+    if (mpz_sgn(v) < 0)
+    {
+        mpz_set_ui(t, 0);
+        mpz_setbit(t, 8 * width);
+        mpz_add(t, t, v);
+    }
+    else
+        mpz_set(t, v);
+
+    size_t count;
+    memset(out, 0, width);
+    mpz_export(out, &count, -1, 1, 0, 0, t);
+}
+
+inline void decode_twos_complement (mpz_t v, const uint8_t *in, size_t width)
+{
+    mpz_import(v, width, -1, 1, 0, 0, in);
+    if (in[width - 1] & 0x80)
+    {
+        mpz_t t;
+        mpz_init(t);
+        mpz_setbit(t, 8 * width);
+        mpz_sub(v, v, t);
+        mpz_clear(t);
+    }
+}
+
+
+// writes a ciphertext column as an Arrow IPC file, one record batch per call of write
+class arrow_column_writer
+{
+public:
+    arrow_column_writer (const std::string &path, size_t byteWidth, bool keyed,
+                         const std::vector<std::pair<std::string, std::string>> &metadata)
+        : ofs_(path, std::ofstream::out | std::ofstream::binary), path_(path), width_(byteWidth), keyed_(keyed),
+          metadata_(metadata), offset_(0)
+    {
+        if (!ofs_)
+            throw std::runtime_error("cannot write " + path);
+        mpz_init(t_);
+
+        std::string magic(ARROW_MAGIC, 6);
+        magic.append(2, '\0');
+        append(magic);
+
+        flatbuffer_builder::table message;
+        message.scalar<int16_t>(0, ARROW_METADATA_V5)
+               .scalar<uint8_t>(1, ARROW_HEADER_SCHEMA)
+               .ref(2, [this](flatbuffer_builder &b) { return b.write(schema()); })
+               .scalar<int64_t>(3, 0);
+        write_message(message, "");
+    }
+    arrow_column_writer (const arrow_column_writer &) = delete;
+    arrow_column_writer &operator= (const arrow_column_writer &) = delete;
+    ~arrow_column_writer () { mpz_clear(t_); }
+
+    // one record batch of rows ciphertexts; keys has rows entries for a keyed column
+    void write (const mpz_rational *values, size_t rows, const std::string *keys)
+    {
+        std::vector<arrow_field_node> nodes;
+        std::vector<arrow_buffer> buffers;
+        std::string body;
+
+        auto add_buffer = [&](const std::string &data)
+        {
+            arrow_buffer buffer = { int64_t(body.size()), int64_t(data.size()) };
+            buffers.push_back(buffer);
+            body.append(data);
+            body.append((ARROW_ALIGNMENT - body.size() % ARROW_ALIGNMENT) % ARROW_ALIGNMENT, '\0');
+        };
+        arrow_field_node node = { int64_t(rows), 0 };
+
+        if (keyed_)
+        {
+            std::string offsets((rows + 1) * sizeof(int32_t), '\0'), data;
+            for (size_t i = 0; i < rows; ++i)
+            {
+                data.append(keys[i]);
+                int32_t end = int32_t(data.size());
+                memcpy(&offsets[(i + 1) * sizeof(int32_t)], &end, sizeof(end));
+            }
+            nodes.push_back(node);
+            add_buffer("");             // no validity bitmap: not nullable
+            add_buffer(offsets);
+            add_buffer(data);
+        }
+
+        for (int component = 0; component < 2; ++component)
+        {
+            std::string data(rows * width_, '\0');
+            for (size_t i = 0; i < rows; ++i)
+                encode_twos_complement(reinterpret_cast<uint8_t *>(&data[i * width_]), width_,
+                                       component ? values[i].Denominator : values[i].Numerator, t_);
+            nodes.push_back(node);
+            add_buffer("");
+            add_buffer(data);
+        }
+
+        flatbuffer_builder::table batch;
+        batch.scalar<int64_t>(0, int64_t(rows))
+             .ref(1, [&](flatbuffer_builder &b) { return b.write_structs(nodes.data(), nodes.size(), sizeof(arrow_field_node)); })
+             .ref(2, [&](flatbuffer_builder &b) { return b.write_structs(buffers.data(), buffers.size(), sizeof(arrow_buffer)); });
+
+        flatbuffer_builder::table message;
+        message.scalar<int16_t>(0, ARROW_METADATA_V5)
+               .scalar<uint8_t>(1, ARROW_HEADER_RECORD_BATCH)
+               .ref(2, [&](flatbuffer_builder &b) { return b.write(batch); })
+               .scalar<int64_t>(3, int64_t(body.size()));
+        blocks_.push_back(write_message(message, body));
+    }
+
+    void close ()
+    {
+        // end of stream, then the footer
+        uint32_t eos[2] = { 0xFFFFFFFFu, 0 };
+        append(std::string(reinterpret_cast<const char *>(eos), sizeof(eos)));
+
+        flatbuffer_builder::table footer;
+        footer.scalar<int16_t>(0, ARROW_METADATA_V5)
+              .ref(1, [this](flatbuffer_builder &b) { return b.write(schema()); })
+              .ref(2, [](flatbuffer_builder &b) { return b.write_structs(nullptr, 0, sizeof(arrow_block)); })
+              .ref(3, [this](flatbuffer_builder &b) { return b.write_structs(blocks_.data(), blocks_.size(), sizeof(arrow_block)); });
+        std::string fb = flatbuffer_builder::finish(footer);
+        int32_t length = int32_t(fb.size());
+        append(fb);
+        append(std::string(reinterpret_cast<const char *>(&length), sizeof(length)));
+        append(std::string(ARROW_MAGIC, 6));
+
+        ofs_.close();
+        if (!ofs_)
+            throw std::runtime_error("cannot write " + path_);
+    }
+
+private:
+    flatbuffer_builder::table schema () const
+    {
+        std::vector<flatbuffer_builder::table> fields;
+        if (keyed_)
+            fields.push_back(field("key", ARROW_TYPE_UTF8));
+        fields.push_back(field("numerator", ARROW_TYPE_FIXED_SIZE_BINARY));
+        fields.push_back(field("denominator", ARROW_TYPE_FIXED_SIZE_BINARY));
+
+        std::vector<flatbuffer_builder::table> metadata;
+        for (const auto &kv : metadata_)
+        {
+            flatbuffer_builder::table entry;
+            std::string key = kv.first, value = kv.second;
+            entry.ref(0, [key](flatbuffer_builder &b) { return b.write_string(key); })
+                 .ref(1, [value](flatbuffer_builder &b) { return b.write_string(value); });
+            metadata.push_back(entry);
+        }
+
+        flatbuffer_builder::table schema;
+        schema.scalar<int16_t>(0, 0)        // little-endian
+              .ref(1, [fields](flatbuffer_builder &b) { return b.write_tables(fields); })
+              .ref(2, [metadata](flatbuffer_builder &b) { return b.write_tables(metadata); });
+        return schema;
+    }
+
+    flatbuffer_builder::table field (const std::string &name, uint8_t type) const
+    {
+        int32_t width = int32_t(width_);
+        flatbuffer_builder::table f;
+        f.ref(0, [name](flatbuffer_builder &b) { return b.write_string(name); })
+         .scalar<uint8_t>(1, 0)             // not nullable
+         .scalar<uint8_t>(2, type)
+         .ref(3, [type, width](flatbuffer_builder &b)
+         {
+             flatbuffer_builder::table t;
+             if (type == ARROW_TYPE_FIXED_SIZE_BINARY)
+                 t.scalar<int32_t>(0, width);
+             return b.write(t);
+         })
+         .ref(5, [](flatbuffer_builder &b) { return b.write_tables(std::vector<flatbuffer_builder::table>()); });
+        return f;
+    }
+
+    // continuation marker, metadata length, metadata padded so the body starts
+    // on ARROW_ALIGNMENT, then the body
+    arrow_block write_message (const flatbuffer_builder::table &message, const std::string &body)
+    {
+        std::string fb = flatbuffer_builder::finish(message);
+        size_t end = offset_ + 8 + fb.size();
+        fb.append((ARROW_ALIGNMENT - end % ARROW_ALIGNMENT) % ARROW_ALIGNMENT, '\0');
+
+        arrow_block block = { int64_t(offset_), int32_t(8 + fb.size()), 0, int64_t(body.size()) };
+        uint32_t prefix[2] = { 0xFFFFFFFFu, uint32_t(fb.size()) };
+        append(std::string(reinterpret_cast<const char *>(prefix), sizeof(prefix)));
+        append(fb);
+        append(body);
+        return block;
+    }
+
+    void append (const std::string &bytes)
+    {
+        ofs_.write(bytes.data(), bytes.size());
+        offset_ += bytes.size();
+    }
+
+    std::ofstream ofs_;
+    std::string path_;
+    size_t width_;
+    bool keyed_;
+    std::vector<std::pair<std::string, std::string>> metadata_;
+    size_t offset_;
+    std::vector<arrow_block> blocks_;
+    mpz_t t_;
+};
+
+
+// one record batch, pointing into the mapped file
+struct arrow_batch_view
+{
+    size_t Rows;
+    const uint8_t *Numerators;      // Rows values of ByteWidth bytes
+    const uint8_t *Denominators;
+    const int32_t *KeyOffsets;      // Rows + 1 offsets into Keys, or null
+    const char *Keys;
+};
+
+// maps an Arrow IPC file of a ciphertext column (as written by
+// arrow_column_writer or any Arrow implementation) and exposes its batches in place
+class arrow_column_reader
+{
+public:
+    explicit arrow_column_reader (const std::string &path) : data_(nullptr), size_(0), width_(0), keyed_(false)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            size_ = size_t(st.st_size);
+            void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            data_ = p == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(p);
+        }
+        ::close(fd);
+        if (!data_)
+            throw std::runtime_error("cannot map " + path);
+
+        try
+        {
+            parse(path);
+        }
+        catch (...)
+        {
+            munmap(const_cast<uint8_t *>(data_), size_);
+            throw;
+        }
+    }
+    arrow_column_reader (const arrow_column_reader &) = delete;
+    arrow_column_reader &operator= (const arrow_column_reader &) = delete;
+    ~arrow_column_reader () { munmap(const_cast<uint8_t *>(data_), size_); }
+
+    size_t byte_width () const { return width_; }
+    bool keyed () const { return keyed_; }
+    const std::map<std::string, std::string> &metadata () const { return metadata_; }
+    const std::vector<arrow_batch_view> &batches () const { return batches_; }
+
+private:
+    void parse (const std::string &path)
+    {
+        const size_t magic = 6;
+        if (size_ < 2 * magic + 4 + 2 || memcmp(data_, ARROW_MAGIC, magic) != 0 ||
+            memcmp(data_ + size_ - magic, ARROW_MAGIC, magic) != 0)
+            throw std::runtime_error(path + " is not an Arrow IPC file");
+
+        int32_t footerLength;
+        memcpy(&footerLength, data_ + size_ - magic - 4, 4);
+        if (footerLength <= 0 || size_t(footerLength) > size_ - 2 * magic - 4)
+            throw std::runtime_error(path + ": corrupt footer");
+        flatbuffer_view footer(data_ + size_ - magic - 4 - footerLength, size_t(footerLength));
+        size_t root = footer.root();
+
+        // fields: optional "key", then "numerator" and "denominator"
+        size_t schema = footer.ref(root, 1);
+        size_t fields = footer.ref(schema, 1);
+        std::vector<std::string> names;
+        for (size_t k = 0; k < footer.length(fields); ++k)
+        {
+            size_t f = footer.table_at(fields, k);
+            std::string name = footer.string(footer.ref(f, 0));
+            uint8_t type = footer.scalar<uint8_t>(f, 2, 0);
+            if (name == "key" && type == ARROW_TYPE_UTF8)
+                keyed_ = true;
+            else if ((name == "numerator" || name == "denominator") && type == ARROW_TYPE_FIXED_SIZE_BINARY)
+            {
+                size_t width = size_t(footer.scalar<int32_t>(footer.ref(f, 3), 0, 0));
+                if (width == 0 || (width_ && width != width_))
+                    throw std::runtime_error(path + ": numerator and denominator differ in width");
+                width_ = width;
+            }
+            else
+                throw std::runtime_error(path + ": unsupported field \"" + name + "\"");
+            names.push_back(name);
+        }
+        std::vector<std::string> expected;
+        if (keyed_)
+            expected.push_back("key");
+        expected.push_back("numerator");
+        expected.push_back("denominator");
+        if (names != expected)
+            throw std::runtime_error(path + ": expected the fields [key,] numerator, denominator");
+
+        size_t metadata = footer.ref(schema, 2);
+        for (size_t k = 0; k < footer.length(metadata); ++k)
+        {
+            size_t kv = footer.table_at(metadata, k);
+            metadata_[footer.string(footer.ref(kv, 0))] = footer.string(footer.ref(kv, 1));
+        }
+        auto encoding = metadata_.find("ahef.encoding");
+        if (encoding != metadata_.end() && encoding->second != ARROW_ENCODING)
+            throw std::runtime_error(path + ": unknown encoding " + encoding->second);
+
+        size_t blocks = footer.ref(root, 3);
+        for (size_t k = 0; k < footer.length(blocks); ++k)
+        {
+            size_t b = footer.element(blocks, k, sizeof(arrow_block));
+            batches_.push_back(batch(path, footer.read<int64_t>(b), footer.read<int32_t>(b + 8),
+                                     footer.read<int64_t>(b + 16)));
+        }
+    }
+
+    arrow_batch_view batch (const std::string &path, int64_t offset, int32_t metaLength, int64_t bodyLength) const
+    {
+        if (offset < 0 || metaLength < 8 || bodyLength < 0 || size_t(offset) + metaLength + bodyLength > size_)
+            throw std::runtime_error(path + ": record batch out of range");
+
+        // continuation marker and length; files before format 0.15 lack the marker
+        const uint8_t *p = data_ + offset;
+        uint32_t first;
+        memcpy(&first, p, 4);
+        size_t skip = first == 0xFFFFFFFFu ? 8 : 4;
+        flatbuffer_view message(p + skip, size_t(metaLength) - skip);
+        size_t root = message.root();
+        if (message.scalar<uint8_t>(root, 1, 0) != ARROW_HEADER_RECORD_BATCH)
+            throw std::runtime_error(path + ": expected a record batch");
+        size_t rb = message.ref(root, 2);
+        if (message.field(rb, 3))
+            throw std::runtime_error(path + ": compressed record batches are not supported");
+
+        arrow_batch_view view;
+        view.Rows = size_t(message.scalar<int64_t>(rb, 0, 0));
+
+        size_t nodes = message.ref(rb, 1);
+        for (size_t k = 0; k < message.length(nodes); ++k)
+            if (message.read<int64_t>(message.element(nodes, k, sizeof(arrow_field_node)) + 8) != 0)
+                throw std::runtime_error(path + ": null ciphertexts are not supported");
+
+        // buffers per field: validity, offsets, data for the key, validity, data for the values
+        const uint8_t *body = p + metaLength;
+        size_t buffers = message.ref(rb, 2);
+        size_t count = message.length(buffers);
+        auto buffer = [&](size_t k, size_t minimum) -> const uint8_t *
+        {
+            if (k >= count)
+                throw std::runtime_error(path + ": missing buffer");
+            size_t b = message.element(buffers, k, sizeof(arrow_buffer));
+            int64_t at = message.read<int64_t>(b), length = message.read<int64_t>(b + 8);
+            if (at < 0 || length < int64_t(minimum) || at + length > bodyLength)
+                throw std::runtime_error(path + ": buffer out of range");
+            return body + at;
+        };
+
+        size_t k = 0;
+        view.KeyOffsets = nullptr;
+        view.Keys = nullptr;
+        if (keyed_)
+        {
+            view.KeyOffsets = reinterpret_cast<const int32_t *>(buffer(k + 1, (view.Rows + 1) * sizeof(int32_t)));
+            int32_t keyBytes;
+            memcpy(&keyBytes, view.KeyOffsets + view.Rows, sizeof(keyBytes));
+            view.Keys = reinterpret_cast<const char *>(buffer(k + 2, size_t(std::max(keyBytes, 0))));
+            k += 3;
+        }
+        view.Numerators = buffer(k + 1, view.Rows * width_);
+        view.Denominators = buffer(k + 3, view.Rows * width_);
+        return view;
+    }
+
+    const uint8_t *data_;
+    size_t size_;
+    size_t width_;
+    bool keyed_;
+    std::map<std::string, std::string> metadata_;
+    std::vector<arrow_batch_view> batches_;
+};
+
+#endif // AHEF_ARROW_HPP
@@ -0,0 +1,191 @@
+/*
+ *  ahefutil arrowenc -p public_key.json -C X.col -o X.arrow
+ *  ahefutil arrowenc -p public_key.json -C groups.col --keyed -o groups.arrow --rows 65536
+ *  ahefutil arrowenc -i X.arrow -o X.col
+ *
+ *  Export a ciphertext column to an Apache Arrow IPC file, or import one back
+ *  to a column file, without an Arrow dependency (see arrow.hpp for the
+ *  layout). Numerator and denominator become FixedSizeBinary fields that
+ *  columnar engines (pyarrow, DuckDB, Polars, ...) read directly and other
+ *  tools can mmap in place; with --keyed the row keys of a keyed column
+ *  ("key numerator denominator" lines) become a Utf8 field "key".
+ *
+ *  The export records the public key fingerprint; an import given -p checks it.
+ *  Keys are detected on import, and the column written keyed if present.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "arrow.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// column file -> Arrow, rows ciphertexts per record batch
+static void export_column (const std::string &input, const std::string &output, const mpz_t N, bool keyed,
+                           size_t rows)
+{
+    std::ifstream ifs(input);
+    if (!ifs)
+        throw std::runtime_error("cannot open " + input);
+
+    std::vector<std::pair<std::string, std::string>> metadata;
+    metadata.push_back(std::make_pair("ahef.encoding", ARROW_ENCODING));
+    metadata.push_back(std::make_pair("ahef.key", key_fingerprint(N)));
+    arrow_column_writer writer(output, arrow_byte_width(N), keyed, metadata);
+
+    std::vector<mpz_rational> values(rows);
+    for (auto &v : values)
+        rational_init(v);
+    std::vector<std::string> keys(keyed ? rows : 0);
+
+    std::string line;
+    size_t n = 0;
+    bool more = true;
+    while (more)
+    {
+        more = static_cast<bool>(std::getline(ifs, line));
+        if (more && (keyed ? parse_keyed_column_line(line, keys[n], values[n]) : parse_column_line(line, values[n])))
+            ++n;
+        if (n == rows || (!more && n > 0))
+        {
+            writer.write(values.data(), n, keyed ? keys.data() : nullptr);
+            n = 0;
+        }
+    }
+    writer.close();
+
+    clear_column(values);
+}
+
+// Arrow -> column file, keyed if the file has keys
+static void import_column (const std::string &input, const std::string &output, const std::string &key)
+{
+    arrow_column_reader reader(input);
+    auto fingerprint = reader.metadata().find("ahef.key");
+    if (!key.empty() && fingerprint != reader.metadata().end() && fingerprint->second != key)
+        throw std::runtime_error(input + " was written under another key");
+
+    std::ofstream ofs(output, std::ofstream::out);
+    if (!ofs)
+        throw std::runtime_error("cannot write " + output);
+
+    mpz_rational r;
+    rational_init(r);
+    size_t width = reader.byte_width();
+    for (const auto &batch : reader.batches())
+    {
+        std::string out;
+        for (size_t i = 0; i < batch.Rows; ++i)
+        {
+            decode_twos_complement(r.Numerator, batch.Numerators + i * width, width);
+            decode_twos_complement(r.Denominator, batch.Denominators + i * width, width);
+            if (reader.keyed())
+                out += format_keyed_column_line(std::string(batch.Keys + batch.KeyOffsets[i],
+                                                            batch.KeyOffsets[i + 1] - batch.KeyOffsets[i]), r);
+            else
+                out += format_column_line(r);
+            out += '\n';
+        }
+        ofs << out;
+    }
+    rational_clear(r);
+
+    ofs.close();
+    if (!ofs)
+        throw std::runtime_error("cannot write " + output);
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("column,C", po::value<std::string>(), "File containing a ciphertext column to export.")
+            ("arrow,i", po::value<std::string>(), "Arrow IPC file to import.")
+            ("keyed", "The column to export is keyed (key numerator denominator).")
+            ("rows", po::value<size_t>()->default_value(65536), "Ciphertexts per record batch (export).")
+            ("publicKey,p", po::value<std::string>(), "File containing public key (required for export).")
+            ("output,o", po::value<std::string>()->required(), "Arrow IPC file (export) or column file (import).");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (vm.count("column") + vm.count("arrow") != 1)
+                throw po::error("exactly one of --column or --arrow is required");
+            if (vm.count("column") && !vm.count("publicKey"))
+                throw po::error("--publicKey is required for export");
+            if (vm["rows"].as<size_t>() == 0)
+                throw po::error("--rows must be positive");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        std::string key;
+        if (vm.count("publicKey"))
+        {
+            read_public_key(vm["publicKey"].as<std::string>(), N);
+            key = key_fingerprint(N);
+        }
+
+        if (vm.count("column"))
+            export_column(vm["column"].as<std::string>(), vm["output"].as<std::string>(), N, vm.count("keyed") > 0,
+                          vm["rows"].as<size_t>());
+        else
+            import_column(vm["arrow"].as<std::string>(), vm["output"].as<std::string>(), key);
+
+        // cleanup
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,204 @@
+/*
+ *  Parallel reading of CSV files (RFC 4180: quoted fields may hold the
+ *  delimiter, line breaks and doubled quotes "").
+ *
+ *  The file is mapped and cut into chunks of about the same number of bytes.
+ *  A quote never occurs outside a quoted field, so whether a byte lies inside
+ *  quotes is the parity of the quotes before it: the quotes of every chunk are
+ *  counted in parallel, a prefix over the chunk counts gives the state at each
+ *  chunk start, and each chunk then moves its start to the first record
+ *  boundary (a line break outside quotes) after it. The resulting ranges hold
+ *  whole records and are parsed independently, by any number of threads.
+ */
+
+#ifndef AHEF_CSV_HPP
+#define AHEF_CSV_HPP
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallel.hpp"
+
+
+// a CSV file mapped read-only
+class csv_file
+{
+public:
+    explicit csv_file (const std::string &path) : data_(nullptr), size_(0)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("cannot open " + path);
+        }
+        if (st.st_size > 0)
+        {
+            size_ = size_t(st.st_size);
+            void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("cannot map " + path);
+            }
+            data_ = static_cast<const char *>(p);
+            madvise(p, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+    csv_file (const csv_file &) = delete;
+    csv_file &operator= (const csv_file &) = delete;
+    ~csv_file ()
+    {
+        if (data_)
+            munmap(const_cast<char *>(data_), size_);
+    }
+
+    const char *data () const { return data_; }
+    size_t size () const { return size_; }
+
+private:
+    const char *data_;
+    size_t size_;
+};
+
+
+// the fields of one record; the strings keep their capacity between records
+struct csv_record
+{
+    std::vector<std::string> Fields;
+    size_t Size = 0;
+
+    bool blank () const { return Size == 1 && Fields[0].empty(); }
+};
+
+// parse the record starting at p into record; returns the start of the next one
+inline const char *csv_parse_record (const char *p, const char *end, char delimiter, csv_record &record)
+{
+    record.Size = 0;
+    while (true)
+    {
+        if (record.Size == record.Fields.size())
+            record.Fields.emplace_back();
+        std::string &field = record.Fields[record.Size++];
+        field.clear();
+
+        if (p < end && *p == '"')
+        {
+            for (++p; p < end; ++p)
+            {
+                if (*p != '"')
+                    field += *p;
+                else if (p + 1 < end && p[1] == '"')
+                    field += *p++;
+                else
+                {
+                    ++p;
+                    break;
+                }
+            }
+        }
+        // unquoted field, or whatever follows a closing quote
+        const char *stop = p;
+        while (stop < end && *stop != delimiter && *stop != '\n')
+            ++stop;
+        field.append(p, stop);
+        p = stop;
+
+        if (p < end && *p == delimiter)
+        {
+            ++p;
+            continue;
+        }
+        if (!field.empty() && field.back() == '\r')
+            field.pop_back();
+        return p < end ? p + 1 : p;
+    }
+}
+
+// cut [first, last) into ranges of whole records of about chunk bytes each
+inline std::vector<std::pair<size_t, size_t>> csv_split (const char *data, size_t first, size_t last, size_t chunk,
+                                                         unsigned threads)
+{
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (first >= last)
+        return ranges;
+    chunk = std::max<size_t>(1, chunk);
+    size_t n = (last - first + chunk - 1) / chunk;
+
+    // quotes per chunk, then the quote state at every chunk start
+    std::vector<size_t> quotes(n);
+    parallel_chunks(n, threads, [&](size_t, size_t a, size_t b)
+    {
+        for (size_t c = a; c < b; ++c)
+        {
+            const char *begin = data + first + c * chunk;
+            quotes[c] = std::count(begin, data + std::min(last, first + (c + 1) * chunk), '"');
+        }
+    });
+    std::vector<char> quoted(n);
+    bool inside = false;
+    for (size_t c = 0; c < n; ++c)
+    {
+        quoted[c] = inside;
+        inside ^= quotes[c] & 1;
+    }
+
+    // move every chunk start past the next line break outside quotes
+    std::vector<size_t> start(n + 1);
+    start[0] = first;
+    start[n] = last;
+    parallel_chunks(n - 1, threads, [&](size_t, size_t a, size_t b)
+    {
+        for (size_t c = a + 1; c < b + 1; ++c)
+        {
+            size_t pos = first + c * chunk;
+            bool q = quoted[c];
+            for (; pos < last; ++pos)
+            {
+                if (data[pos] == '"')
+                    q = !q;
+                else if (data[pos] == '\n' && !q)
+                {
+                    ++pos;
+                    break;
+                }
+            }
+            start[c] = pos;
+        }
+    });
+
+    // a record longer than a chunk leaves empty ranges behind
+    for (size_t c = 0; c < n; ++c)
+        if (start[c] < start[c + 1])
+            ranges.push_back(std::make_pair(start[c], start[c + 1]));
+    return ranges;
+}
+
+// column given as a header name or a 1-based index, as cut -f; -1 if unknown
+inline long csv_column_index (const std::string &spec, const csv_record *header)
+{
+    if (!spec.empty() && spec.find_first_not_of("0123456789") == std::string::npos)
+    {
+        long index = std::stol(spec);
+        return index > 0 ? index - 1 : -1;
+    }
+    if (header)
+        for (size_t i = 0; i < header->Size; ++i)
+            if (header->Fields[i] == spec)
+                return long(i);
+    return -1;
+}
+
+#endif // AHEF_CSV_HPP
@@ -0,0 +1,534 @@
+/*
+ *  Computation graphs of homomorphic operations and their parallel executor.
+ *
+ *  A graph is a JSON object listing its nodes in any order:
+ *
+ *      { "nodes": [
+ *          { "id": "a",  "op": "input", "file": "A.enc" },
+ *          { "id": "b",  "op": "input", "file": "B.enc" },
+ *          { "id": "ab", "op": "mul", "args": ["a", "b"] },
+ *          { "id": "y",  "op": "add", "args": ["ab", "a"], "output": "Y.enc" } ] }
+ *
+ *  "input" loads a ciphertext file; "add" and "mul" take two or more
+ *  arguments (folded left to right), "sub" exactly two. Any node with an
+ *  "output" is written to that ciphertext file as soon as it is computed.
+ *
+ *  Before running, optimize_dag hash-conses the graph: every node gets a
+ *  content hash, SHA-256 over its operation, the public key and the hashes of
+ *  its arguments (sorted for add and mul), with inputs hashed by ciphertext.
+ *  Nodes with equal hashes compute the same value and are merged into one.
+ *  With a cache directory, results are also looked up and stored there under
+ *  their hash, so a node computed by an earlier run is loaded instead, and
+ *  whatever only fed cached or unused nodes is dropped.
+ *
+ *  The executor runs every node once all of its arguments are done, on a
+ *  work-stealing pool: a finished node pushes the consumers it made ready onto
+ *  its own worker's deque (newest first, while their operands are hot) and idle
+ *  workers steal the oldest entries of other deques. Intermediates stay in
+ *  memory and are freed when their last consumer has finished.
+ */
+
+#ifndef AHEF_DAG_HPP
+#define AHEF_DAG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "ahef_gmp.hpp"
+
+
+enum dag_op { DAG_INPUT, DAG_ADD, DAG_SUB, DAG_MUL };
+
+struct dag_node
+{
+    std::string Id;
+    dag_op Op;
+    std::string File;                   // DAG_INPUT: ciphertext to load
+    std::vector<std::string> Outputs;   // ciphertext files to write
+    std::vector<size_t> Args;           // argument nodes, in order
+    std::vector<size_t> Consumers;      // one entry per use as an argument
+    std::string Hash;                   // content hash (optimize_dag)
+    std::string CacheFile;              // store the result here, or empty
+};
+
+struct dag
+{
+    std::vector<dag_node> Nodes;
+    std::vector<size_t> Order;          // a topological order of Nodes
+};
+
+struct dag_stats
+{
+    double WallSeconds;
+    double WorkSeconds;                 // sum of all node times
+    double CriticalSeconds;             // longest chain of dependent node times
+    std::vector<size_t> CriticalPath;   // that chain, first node first
+    size_t PeakLive;                    // most ciphertexts held in memory at once
+};
+
+struct dag_plan_stats
+{
+    size_t Nodes;                       // nodes before optimizing
+    size_t Merged;                      // duplicates merged into an equal node
+    size_t CacheHits;                   // needed results loaded from the cache
+    size_t Pruned;                      // nodes no longer needed
+};
+
+
+inline dag_op parse_dag_op (const std::string &op)
+{
+    if (op == "input") return DAG_INPUT;
+    if (op == "add") return DAG_ADD;
+    if (op == "sub") return DAG_SUB;
+    if (op == "mul") return DAG_MUL;
+    throw std::runtime_error("unknown operation \"" + op + "\"");
+}
+
+// derive Consumers and Order from Args; throws if the graph has a cycle
+inline void link_dag (dag &g)
+{
+    for (auto &node : g.Nodes)
+        node.Consumers.clear();
+    for (size_t k = 0; k < g.Nodes.size(); ++k)
+        for (size_t a : g.Nodes[k].Args)
+            g.Nodes[a].Consumers.push_back(k);
+
+    // Kahn's algorithm; whatever is left over lies on a cycle
+    g.Order.clear();
+    std::vector<size_t> pending(g.Nodes.size());
+    for (size_t k = 0; k < g.Nodes.size(); ++k)
+    {
+        pending[k] = g.Nodes[k].Args.size();
+        if (pending[k] == 0)
+            g.Order.push_back(k);
+    }
+    for (size_t next = 0; next < g.Order.size(); ++next)
+        for (size_t c : g.Nodes[g.Order[next]].Consumers)
+            if (--pending[c] == 0)
+                g.Order.push_back(c);
+    if (g.Order.size() != g.Nodes.size())
+        throw std::runtime_error("the graph has a cycle");
+}
+
+// parse and validate a graph; throws on unknown ids, wrong arities and cycles
+inline void parse_dag (const nlohmann::json &j, dag &g)
+{
+    std::map<std::string, size_t> index;
+    const nlohmann::json &nodes = j.at("nodes");
+    for (const auto &n : nodes)
+    {
+        dag_node node;
+        node.Id = n.at("id").get<std::string>();
+        node.Op = parse_dag_op(n.at("op").get<std::string>());
+        if (node.Op == DAG_INPUT)
+            node.File = n.at("file").get<std::string>();
+        if (n.count("output"))
+            node.Outputs.push_back(n["output"].get<std::string>());
+        if (!index.emplace(node.Id, g.Nodes.size()).second)
+            throw std::runtime_error("duplicate node \"" + node.Id + "\"");
+        g.Nodes.push_back(node);
+    }
+
+    for (size_t k = 0; k < g.Nodes.size(); ++k)
+    {
+        dag_node &node = g.Nodes[k];
+        if (nodes[k].count("args"))
+        {
+            for (const auto &a : nodes[k]["args"])
+            {
+                auto it = index.find(a.get<std::string>());
+                if (it == index.end())
+                    throw std::runtime_error("node \"" + node.Id + "\" uses unknown node \"" + a.get<std::string>() + "\"");
+                node.Args.push_back(it->second);
+            }
+        }
+
+        size_t arity = node.Args.size();
+        if ((node.Op == DAG_INPUT && arity != 0) || (node.Op == DAG_SUB && arity != 2) ||
+            ((node.Op == DAG_ADD || node.Op == DAG_MUL) && arity < 2))
+            throw std::runtime_error("wrong number of arguments for node \"" + node.Id + "\"");
+    }
+
+    link_dag(g);
+}
+
+inline std::string dag_op_name (dag_op op)
+{
+    switch (op)
+    {
+    case DAG_INPUT: return "input";
+    case DAG_ADD: return "add";
+    case DAG_SUB: return "sub";
+    case DAG_MUL: return "mul";
+    }
+    return "";
+}
+
+// hash-cons g under the public key N: merge nodes of equal content hash, then
+// (with a cacheDir) load cached results and mark the rest for storing, and
+// drop every node no output depends on
+inline void optimize_dag (dag &g, const mpz_t N, const std::string &cacheDir, dag_plan_stats &stats)
+{
+    size_t n = g.Nodes.size();
+    stats.Nodes = n;
+    stats.Merged = stats.CacheHits = stats.Pruned = 0;
+
+    // content hashes in topological order; canon[k] is the first node with k's hash
+    std::string key = key_fingerprint(N);
+    std::vector<size_t> canon(n);
+    std::map<std::string, size_t> byHash;
+    mpz_rational c;
+    rational_init(c);
+    for (size_t k : g.Order)
+    {
+        dag_node &node = g.Nodes[k];
+        for (auto &a : node.Args)
+            a = canon[a];
+
+        if (node.Op == DAG_INPUT)
+        {
+            read_ciphertext(node.File, c);
+            node.Hash = sha256_hex("input " + format_column_line(c));
+        }
+        else
+        {
+            std::vector<std::string> args;
+            for (size_t a : node.Args)
+                args.push_back(g.Nodes[a].Hash);
+            if (node.Op != DAG_SUB)
+                std::sort(args.begin(), args.end());
+            std::string text = dag_op_name(node.Op) + " " + key;
+            for (const auto &h : args)
+                text += " " + h;
+            node.Hash = sha256_hex(text);
+        }
+
+        auto it = byHash.emplace(node.Hash, k);
+        canon[k] = it.first->second;
+        if (!it.second)
+        {
+            dag_node &first = g.Nodes[canon[k]];
+            first.Outputs.insert(first.Outputs.end(), node.Outputs.begin(), node.Outputs.end());
+            ++stats.Merged;
+        }
+    }
+    rational_clear(c);
+
+    // cached results become inputs
+    std::vector<bool> cached(n, false);
+    if (!cacheDir.empty())
+    {
+        if (mkdir(cacheDir.c_str(), 0755) != 0 && errno != EEXIST)
+            throw std::runtime_error("cannot create " + cacheDir);
+        for (size_t k = 0; k < n; ++k)
+        {
+            dag_node &node = g.Nodes[k];
+            if (canon[k] != k || node.Op == DAG_INPUT)
+                continue;
+            std::string path = cacheDir + "/" + node.Hash + ".json";
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0)
+            {
+                node.Op = DAG_INPUT;
+                node.File = path;
+                node.Args.clear();
+                cached[k] = true;
+            }
+            else
+            {
+                node.CacheFile = path;
+            }
+        }
+    }
+
+    // keep what the outputs need
+    std::vector<bool> needed(n, false);
+    std::vector<size_t> stack;
+    for (size_t k = 0; k < n; ++k)
+        if (canon[k] == k && !g.Nodes[k].Outputs.empty())
+            stack.push_back(k);
+    while (!stack.empty())
+    {
+        size_t k = stack.back();
+        stack.pop_back();
+        if (needed[k])
+            continue;
+        needed[k] = true;
+        for (size_t a : g.Nodes[k].Args)
+            stack.push_back(a);
+    }
+
+    std::vector<size_t> index(n);
+    dag out;
+    for (size_t k = 0; k < n; ++k)
+    {
+        if (!needed[k])
+        {
+            stats.Pruned += canon[k] == k;
+            continue;
+        }
+        stats.CacheHits += cached[k];
+        index[k] = out.Nodes.size();
+        out.Nodes.push_back(g.Nodes[k]);
+    }
+    for (auto &node : out.Nodes)
+        for (auto &a : node.Args)
+            a = index[a];
+    link_dag(out);
+    g = out;
+}
+
+
+// a pool of workers with one deque each; owners work LIFO, thieves FIFO
+class work_stealing_pool
+{
+public:
+    explicit work_stealing_pool (unsigned threads) : queued_(0), outstanding_(0), failed_(false)
+    {
+        for (unsigned w = 0; w < std::max(1u, threads); ++w)
+            deques_.emplace_back(new worker_deque);
+    }
+
+    unsigned size () const { return unsigned(deques_.size()); }
+
+    // schedule item on worker's deque
+    void push (unsigned worker, size_t item)
+    {
+        ++outstanding_;
+        {
+            std::lock_guard<std::mutex> lock(deques_[worker]->Mutex);
+            deques_[worker]->Items.push_back(item);
+        }
+        ++queued_;
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        wake_.notify_one();
+    }
+
+    // run task(worker, item) until every pushed item (including those pushed
+    // by tasks) is done; rethrows the first exception of a task
+    template <typename Task>
+    void run (Task task)
+    {
+        std::vector<std::thread> threads;
+        for (unsigned w = 0; w < size(); ++w)
+            threads.emplace_back([this, w, &task] { work(w, task); });
+        for (auto &t : threads)
+            t.join();
+        if (error_)
+            std::rethrow_exception(error_);
+    }
+
+private:
+    struct worker_deque
+    {
+        std::mutex Mutex;
+        std::deque<size_t> Items;
+    };
+
+    bool pop (unsigned worker, size_t &item)
+    {
+        // own deque, newest first
+        {
+            worker_deque &d = *deques_[worker];
+            std::lock_guard<std::mutex> lock(d.Mutex);
+            if (!d.Items.empty())
+            {
+                item = d.Items.back();
+                d.Items.pop_back();
+                --queued_;
+                return true;
+            }
+        }
+        // steal the oldest item of another worker
+        for (unsigned k = 1; k < size(); ++k)
+        {
+            worker_deque &d = *deques_[(worker + k) % size()];
+            std::lock_guard<std::mutex> lock(d.Mutex);
+            if (!d.Items.empty())
+            {
+                item = d.Items.front();
+                d.Items.pop_front();
+                --queued_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename Task>
+    void work (unsigned worker, Task &task)
+    {
+        size_t item;
+        while (!failed_)
+        {
+            if (pop(worker, item))
+            {
+                try
+                {
+                    task(worker, item);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(sleepMutex_);
+                    if (!failed_)
+                        error_ = std::current_exception();
+                    failed_ = true;
+                    wake_.notify_all();
+                    return;
+                }
+                if (--outstanding_ == 0)
+                {
+                    std::lock_guard<std::mutex> lock(sleepMutex_);
+                    wake_.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wake_.wait(lock, [this] { return failed_ || queued_ > 0 || outstanding_ == 0; });
+            if (outstanding_ == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<worker_deque>> deques_;
+    std::atomic<size_t> queued_;        // items sitting in deques
+    std::atomic<size_t> outstanding_;   // items pushed and not yet finished
+    std::atomic<bool> failed_;
+    std::exception_ptr error_;
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+};
+
+
+// evaluate g under the public key N with `threads` workers
+inline void run_dag (const dag &g, const mpz_t N, unsigned threads, dag_stats &stats)
+{
+    typedef std::chrono::steady_clock clock;
+    size_t n = g.Nodes.size();
+
+    std::vector<mpz_rational> value(n);
+    std::unique_ptr<std::atomic<size_t>[]> pending(new std::atomic<size_t>[n]);
+    std::unique_ptr<std::atomic<size_t>[]> uses(new std::atomic<size_t>[n]);
+    std::vector<double> seconds(n, 0.0);
+    std::atomic<size_t> live(0), peak(0);
+
+    work_stealing_pool pool(threads);
+    for (size_t k = 0; k < n; ++k)
+    {
+        pending[k] = g.Nodes[k].Args.size();
+        uses[k] = g.Nodes[k].Consumers.size();
+    }
+
+    auto release = [&](size_t k)
+    {
+        if (--uses[k] == 0)
+        {
+            rational_clear(value[k]);
+            --live;
+        }
+    };
+
+    auto evaluate = [&](unsigned worker, size_t k)
+    {
+        const dag_node &node = g.Nodes[k];
+        auto start = clock::now();
+
+        rational_init(value[k]);
+        size_t now = ++live;
+        for (size_t p = peak; now > p && !peak.compare_exchange_weak(p, now); )
+            ;
+
+        switch (node.Op)
+        {
+        case DAG_INPUT:
+            read_ciphertext(node.File, value[k]);
+            break;
+        case DAG_SUB:
+            sub_rational(value[k], value[node.Args[0]], value[node.Args[1]], N);
+            break;
+        case DAG_ADD:
+        case DAG_MUL:
+            rational_set(value[k], value[node.Args[0]]);
+            for (size_t a = 1; a < node.Args.size(); ++a)
+            {
+                if (node.Op == DAG_ADD)
+                    add_rational(value[k], value[k], value[node.Args[a]], N);
+                else
+                    mul_rational(value[k], value[k], value[node.Args[a]], N);
+            }
+            break;
+        }
+        for (const auto &file : node.Outputs)
+            write_ciphertext(file, value[k]);
+        if (!node.CacheFile.empty())
+            write_json_atomic(node.CacheFile, ciphertext_to_json(value[k]));
+        seconds[k] = std::chrono::duration<double>(clock::now() - start).count();
+
+        // free arguments whose last consumer this was, then schedule the
+        // consumers this node made ready
+        for (size_t a : node.Args)
+            release(a);
+        if (node.Consumers.empty())
+        {
+            rational_clear(value[k]);
+            --live;
+        }
+        for (size_t c : node.Consumers)
+            if (--pending[c] == 0)
+                pool.push(worker, c);
+    };
+
+    // deal the sources out round robin
+    unsigned next = 0;
+    for (size_t k : g.Order)
+    {
+        if (!g.Nodes[k].Args.empty())
+            break;
+        pool.push(next, k);
+        next = (next + 1) % pool.size();
+    }
+
+    auto start = clock::now();
+    pool.run(evaluate);
+    stats.WallSeconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    // longest chain of measured node times, in topological order
+    std::vector<double> finish(n, 0.0);
+    std::vector<size_t> via(n, n);
+    stats.WorkSeconds = 0;
+    size_t last = n;
+    for (size_t k : g.Order)
+    {
+        for (size_t a : g.Nodes[k].Args)
+        {
+            if (via[k] == n || finish[a] > finish[via[k]])
+                via[k] = a;
+        }
+        finish[k] = seconds[k] + (via[k] == n ? 0.0 : finish[via[k]]);
+        stats.WorkSeconds += seconds[k];
+        if (last == n || finish[k] > finish[last])
+            last = k;
+    }
+    stats.CriticalSeconds = last == n ? 0.0 : finish[last];
+    stats.CriticalPath.clear();
+    for (size_t k = last; k != n; k = via[k])
+        stats.CriticalPath.push_back(k);
+    std::reverse(stats.CriticalPath.begin(), stats.CriticalPath.end());
+    stats.PeakLive = peak;
+}
+
+#endif // AHEF_DAG_HPP
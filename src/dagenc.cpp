@@ -0,0 +1,134 @@
+/*
+ *  ahefutil dagenc -p public_key.json -g job.json -t 8 --stats
+ *  ahefutil dagenc -p public_key.json -g nightly.json --cache results/
+ *
+ *  Evaluate a whole graph of homomorphic add/sub/mul operations (see dag.hpp
+ *  for the JSON format) in one process, instead of a shell script running
+ *  addenc, subenc and mulenc one node at a time. Independent nodes run in
+ *  parallel on a work-stealing pool, intermediates never touch the disk and
+ *  are freed after their last use, and only nodes with an "output" are written.
+ *
+ *  Identical subexpressions (same operation on ciphertexts of the same content,
+ *  also via different input files or node ids) are computed once. With
+ *  --cache every computed node is stored in the directory under its content
+ *  hash, and later runs load it from there instead of recomputing it and
+ *  everything it depends on.
+ *
+ *  --stats reports the wall time, the total work, the critical path (the
+ *  longest chain of dependent node times, a lower bound for the wall time on
+ *  any number of threads) and the most ciphertexts held in memory at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "dag.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+static void print_stats (std::ostream &os, const dag &g, const dag_plan_stats &plan, const dag_stats &stats,
+                         unsigned threads)
+{
+    os << plan.Nodes << " nodes: " << plan.Merged << " duplicates merged, " << plan.CacheHits << " loaded from cache, "
+       << plan.Pruned << " unused" << std::endl;
+    os << g.Nodes.size() << " nodes on " << threads << " threads: " << stats.WallSeconds << " s wall, "
+       << stats.WorkSeconds << " s work, critical path " << stats.CriticalSeconds << " s ("
+       << stats.CriticalPath.size() << " nodes";
+    if (stats.CriticalSeconds > 0)
+        os << ", parallelism " << stats.WorkSeconds / stats.CriticalSeconds;
+    os << "), at most " << stats.PeakLive << " ciphertexts in memory" << std::endl;
+
+    os << "critical path:";
+    for (size_t k : stats.CriticalPath)
+        os << " " << g.Nodes[k].Id;
+    os << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("graph,g", po::value<std::string>()->required(), "File containing the computation graph (JSON).")
+            ("cache", po::value<std::string>(), "Directory of results by content hash, reused across runs.")
+            ("stats", "Print timings and the critical path to stderr.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads.");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        dag g;
+        parse_dag(read_json(vm["graph"].as<std::string>()), g);
+
+        dag_plan_stats plan;
+        optimize_dag(g, N, vm.count("cache") ? vm["cache"].as<std::string>() : "", plan);
+
+        dag_stats stats;
+        unsigned threads = std::max(1u, vm["threads"].as<unsigned>());
+        run_dag(g, N, threads, stats);
+
+        if (vm.count("stats"))
+            print_stats(std::cerr, g, plan, stats, threads);
+
+        // cleanup
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
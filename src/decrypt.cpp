@@ -3,13 +3,19 @@
  *
  *  Decrypts cipertext as x = D(c) = fmod(c,p) and writes to stdout.
  *
+ *  With --lanes k the plaintext is a packed one (see encrypt --packed) and
+ *  its k signed integer lanes are written on one line.
+ *
+ *  With -C every ciphertext of a column (or keyed column, e.g. from groupenc)
+ *  is decrypted to one output line, prefixed by its key.
+ *
  */
 
 #define _OPEN_SYS_ITOA_EXT
 #include <stdio.h>
 #include <stdlib.h>
-#include <gcrypt.h>
 #include <fstream>
+#include <sstream>
 #include <cmath>
 #include <limits>
 #include <algorithm>
@@ -18,6 +24,7 @@
 #include "boost/program_options.hpp" 
 
 #include <gmp.h>
+#include "ahef_gmp.hpp"
 
 
 
@@ -30,31 +37,90 @@ namespace
 } // namespace 
 
 
-static void die (const char *format, ...)
+// x = (a mod p) / (b mod p) with balanced residues, which agree with smod for
+// fresh ciphertexts and also give the right sign for sums of mixed signs and
+// differences, whose numerator sign says nothing
+static void print_plaintext (const mpz_rational &c, const mpz_t p)
 {
-  va_list arg_ptr;
-
-  va_start (arg_ptr, format);
-  vfprintf (stderr, format, arg_ptr);
-  va_end (arg_ptr);
-  exit (1);
+    mpz_t a, b;
+    mpz_init_set(a, c.Numerator);
+    mpz_init_set(b, c.Denominator);
+    balanced_mod(a, p);
+    balanced_mod(b, p);
+
+    mpf_t A, B, C;
+    mp_bitcnt_t prec = mpz_sizeinbase(a, 2) + mpz_sizeinbase(b, 2);
+    mpf_init2(A, prec);
+    mpf_init2(B, prec);
+    mpf_init2(C, prec);
+    mpf_set_z(A, a);
+    mpf_set_z(B, b);
+    mpf_div(C, A, B);
+    mpf_out_str(stdout, 10, 30, C);
+
+    mpf_clear(A);
+    mpf_clear(B);
+    mpf_clear(C);
+    mpz_clear(a);
+    mpz_clear(b);
 }
 
-static std::string toString ( gcry_mpi_t a)
+// decrypt every ciphertext of a plain or keyed column, one "[key] value" line each
+static void decrypt_column (const std::string &path, const mpz_t p, size_t lanes, unsigned laneBits)
 {
-    unsigned char *buf;
-    size_t bufSize;
-    gcry_mpi_aprint (GCRYMPI_FMT_HEX, &buf, &bufSize, a);
-    std::string std_string(reinterpret_cast<const char *>(buf), bufSize-1);
-    gcry_free (buf);
-    return std_string;
-}
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error("cannot open " + path);
+
+    std::string line, key;
+    mpz_rational c;
+    rational_init(c);
+    while (std::getline(ifs, line))
+    {
+        std::istringstream tokens(line);
+        std::string token;
+        size_t count = 0;
+        while (tokens >> token)
+            ++count;
 
-struct Cipher
-{
-    gcry_mpi_t Numerator;
-    gcry_mpi_t Denominator;
-} cipherText;
+        if (count == 3)
+        {
+            if (!parse_keyed_column_line(line, key, c))
+                continue;
+            printf("%s ", key.c_str());
+        }
+        else if (!parse_column_line(line, c))
+        {
+            continue;
+        }
+
+        if (lanes)
+        {
+            mpz_t x, d;
+            mpz_init(x);
+            mpz_init(d);
+            if (!mpz_invert(d, c.Denominator, p))
+            {
+                mpz_clear(x);
+                mpz_clear(d);
+                rational_clear(c);
+                throw std::runtime_error("denominator is not invertible mod p");
+            }
+            mpz_mul(x, c.Numerator, d);
+            std::vector<std::string> values = unpack_lanes(x, p, lanes, laneBits);
+            for (size_t i = 0; i < values.size(); ++i)
+                printf(i ? " %s" : "%s", values[i].c_str());
+            mpz_clear(x);
+            mpz_clear(d);
+        }
+        else
+        {
+            print_plaintext(c, p);
+        }
+        printf("\n");
+    }
+    rational_clear(c);
+}
 
 
 int main(int argc, char** argv)
@@ -65,7 +131,11 @@ int main(int argc, char** argv)
         po::options_description description("Usage");
         description.add_options()
             ("help,h", "Display this help message") 
-            ("cipherText,c", po::value<std::string>()->required(), "File containing ciphertext.")
+            ("cipherText,c", po::value<std::string>(), "File containing ciphertext.")
+            ("column,C", po::value<std::string>(), "File containing a (keyed) ciphertext column, decrypted to one line per ciphertext.")
+            ("field,f", po::value<std::string>(), "Decrypt the ciphertext stored under this key of an aggregate file (e.g. sum, sumOfSquares).")
+            ("lanes", po::value<size_t>(), "Unpack this many integer lanes of a packed ciphertext.")
+            ("laneBits", po::value<unsigned>()->default_value(64), "Bits per packed lane.")
             ("privateKeys,p", po::value<std::string>()->required(), "File containing private keys.");
            
         po::variables_map vm;
@@ -81,6 +151,9 @@ int main(int argc, char** argv)
             }
             
             po::notify(vm);    
+
+            if (vm.count("cipherText") + vm.count("column") != 1)
+                throw po::error("exactly one of --cipherText or --column is required");
         }
         catch(po::error& e) 
         { 
@@ -91,28 +164,25 @@ int main(int argc, char** argv)
         
     // app code goes here
         
-        // initialize MPI subsystem
-        gcry_control (GCRYCTL_DISABLE_SECMEM, 0);
-        if (! gcry_check_version (GCRYPT_VERSION))
-            die ("version mismatch\n");
-        gcry_control (GCRYCTL_INITIALIZATION_FINISHED, 0);
-
-
         // read privateKeys from file 
         nlohmann::json private_keys;
         std::ifstream privateKeysStream(vm["privateKeys"].as<std::string>());
         privateKeysStream >> private_keys;
         privateKeysStream.close();
         
-        // parse and construct grcy_mpi_t
+        // only p is needed: x = D(c) = fmod(c,p)
         std::string pString = private_keys["p"];
-        std::string qString = private_keys["q"];
-        gcry_mpi_t p,q;
-        size_t scanned;
-        p = gcry_mpi_new(0);
-        q = gcry_mpi_new(0);
-        gcry_mpi_scan(&p, GCRYMPI_FMT_HEX, pString.c_str(), 0, &scanned);
-        gcry_mpi_scan(&q, GCRYMPI_FMT_HEX, qString.c_str(), 0, &scanned);
+
+        if (vm.count("column"))
+        {
+            mpz_t P;
+            mpz_init(P);
+            set_hex(P, pString);
+            decrypt_column(vm["column"].as<std::string>(), P, vm.count("lanes") ? vm["lanes"].as<size_t>() : 0,
+                           vm["laneBits"].as<unsigned>());
+            mpz_clear(P);
+            return SUCCESS;
+        }
 
         // read ciphertext from file
         nlohmann::json ciphertext;
@@ -120,99 +190,55 @@ int main(int argc, char** argv)
         ciphertextStream >> ciphertext;
         ciphertextStream.close();
         
-        // parse and construct grcy_mpi_t
+        if (vm.count("field"))
+            ciphertext = nlohmann::json(ciphertext.at(vm["field"].as<std::string>()));
+        
         std::string denomStr = ciphertext["denominator"];
         std::string numStr = ciphertext["numerator"];
-        
-        gcry_mpi_t num, denom;
-        num = gcry_mpi_new(0);
-        denom = gcry_mpi_new(0);
-        gcry_mpi_scan(&num, GCRYMPI_FMT_HEX, numStr.c_str(), 0, &scanned);
-        gcry_mpi_scan(&denom, GCRYMPI_FMT_HEX, denomStr.c_str(), 0, &scanned);
-        
-        // decrypt ciphertext: x = D(c) = fmod(c,p) = smod(a,p) / smod(b,p)
-        gcry_mpi_t X_n = gcry_mpi_new (0);
-        
-        if (gcry_mpi_is_neg(num))
-        {
-            gcry_mpi_abs (num);
-            gcry_mpi_mod(X_n, num, p);
-            gcry_mpi_neg (X_n, X_n);
-        }
-        else
+
+        // packed plaintext: x = num * denom^-1 mod p, split into signed lanes
+        if (vm.count("lanes"))
         {
-            gcry_mpi_mod(X_n, num, p);
+            mpz_t P, X, D;
+            mpz_init(P);
+            mpz_init(X);
+            mpz_init(D);
+            set_hex(P, pString);
+            set_hex(X, numStr);
+            set_hex(D, denomStr);
+            if (!mpz_invert(D, D, P))
+            {
+                mpz_clear(P);
+                mpz_clear(X);
+                mpz_clear(D);
+                throw std::runtime_error("denominator is not invertible mod p");
+            }
+            mpz_mul(X, X, D);
+
+            std::vector<std::string> lanes = unpack_lanes(X, P, vm["lanes"].as<size_t>(), vm["laneBits"].as<unsigned>());
+            for (size_t i = 0; i < lanes.size(); ++i)
+                std::cout << (i ? " " : "") << lanes[i];
+            std::cout << std::endl;
+
+            mpz_clear(P);
+            mpz_clear(X);
+            mpz_clear(D);
+            return SUCCESS;
         }
         
-        
-        gcry_mpi_t X_d = gcry_mpi_new (0);
-        
-        if (gcry_mpi_is_neg(denom))
-        {
-            gcry_mpi_abs (denom);
-            gcry_mpi_mod(X_d, denom, p);
-            gcry_mpi_neg (X_d, X_d);
-        }
-        else
+        // decrypt ciphertext: x = D(c) = fmod(c,p) = (a mod p) / (b mod p)
         {
-            gcry_mpi_mod(X_d, denom, p);
+            mpz_rational c;
+            mpz_t P;
+            rational_init(c);
+            mpz_init(P);
+            set_hex(P, pString);
+            set_hex(c.Numerator, numStr);
+            set_hex(c.Denominator, denomStr);
+            print_plaintext(c, P);
+            rational_clear(c);
+            mpz_clear(P);
         }
-
-        // print cleartext to stdout
-        gcry_mpi_t gcd = gcry_mpi_new(0);
-        gcry_mpi_gcd(gcd, X_n, X_d);
-        
-        // simplify fraction
-        gcry_mpi_t a = gcry_mpi_new(0);
-        gcry_mpi_t b = gcry_mpi_new(0);
-        gcry_mpi_div (a, NULL, X_n, gcd, 0);
-        gcry_mpi_div (b, NULL, X_d, gcd, 0);
-        
-
-        mpf_set_default_prec( gcry_mpi_get_nbits(X_n) + gcry_mpi_get_nbits(X_d) );
-        mpf_t A, B, C;
-        mpf_init_set_str(A, toString(X_n).c_str(), 16);
-        mpf_init_set_str(B, toString(X_d).c_str(), 16);
-        mpf_init (C);
-        
-        mpf_div(C, A, B);
-        mpf_out_str(0, 10, 30, C);
-        
-        
-/*        
-        mpz_t A, B;
-        mpz_init (A);
-        mpz_init (B);
-        mpz_set_str(A, toString(X_n).c_str(), 16);
-        mpz_set_str(B, toString(X_d).c_str(), 16);
-        
-        mpq_t result;
-        mpq_init (result);
-        mpq_set_num (result, A);
-        mpq_set_den (result, B);
-        
-        mpq_canonicalize (result);
-        std::cout << mpq_out_str(0, 10, result) << std::endl;
-*/        
-        
-            /*
-
-        
-        std::cout << "#a " << gcry_mpi_get_nbits(X_n)  << std::endl;
-        std::cout << "#b " << gcry_mpi_get_nbits(X_d)  << std::endl;
-        
-        std::cout << "a " << toString(X_n).c_str() << std::endl;
-        std::cout << "b " << toString(X_d).c_str() << std::endl;
-        
-        */
-
-        // cleanup
-        gcry_mpi_release(p);
-        gcry_mpi_release(q);
-        gcry_mpi_release(num);
-        gcry_mpi_release(denom);
-        gcry_mpi_release(X_n);
-        gcry_mpi_release(X_d);
     }
     catch (std::exception& e) 
     { 
@@ -0,0 +1,192 @@
+/*
+ *  ahefutil dirsum -p public_key.json -d day/ -o total.json -t 4
+ *
+ *  Add up every ciphertext file (*.enc, as written by encrypt) in one or more
+ *  directories and write the encrypted sum and count as an aggregate file.
+ *
+ *  The reader thread loads the files in batches through io_uring (uring.hpp),
+ *  submitting all opens, reads and closes of a batch at once; the workers parse
+ *  the JSON and fold the ciphertexts into per-thread partial sums. Without
+ *  io_uring (or with --no-uring) each worker reads its files itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+#include "uring.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+  // largest ciphertext file read through the ring, bigger ones are read by the worker
+  const size_t MAX_URING_FILE = 64 * 1024;
+
+} // namespace
+
+
+struct file_batch
+{
+    std::vector<std::string> Paths;
+    std::vector<std::string> Contents;
+    std::vector<bool> Failed;
+};
+
+
+static bool has_suffix (const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// append the paths of all regular files ending in suffix
+static void list_directory (const std::string &dir, const std::string &suffix, std::vector<std::string> &paths)
+{
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        throw std::runtime_error("cannot open directory " + dir);
+
+    std::string prefix = has_suffix(dir, "/") ? dir : dir + "/";
+    while (struct dirent *entry = readdir(d))
+    {
+        if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+            continue;
+        std::string name(entry->d_name);
+        if (has_suffix(name, suffix))
+            paths.push_back(prefix + name);
+    }
+    closedir(d);
+}
+
+static std::string read_file (const std::string &path)
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error("cannot open " + path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("directory,d", po::value<std::vector<std::string>>()->required(), "Directory containing ciphertext files (repeatable).")
+            ("suffix,x", po::value<std::string>()->default_value(".enc"), "File name suffix of ciphertext files.")
+            ("squares,q", "Also compute the encrypted sum of squares.")
+            ("no-uring", "Read files with a plain thread pool instead of io_uring.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted aggregate.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads.");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        std::vector<std::string> paths;
+        for (const auto &dir : vm["directory"].as<std::vector<std::string>>())
+            list_directory(dir, vm["suffix"].as<std::string>(), paths);
+
+        pipeline_options opt = default_pipeline_options(vm["threads"].as<unsigned>());
+        std::vector<encrypted_aggregate> partial(opt.Threads);
+        for (auto &a : partial)
+            aggregate_init(a, vm.count("squares") > 0);
+
+        // a ring without entries is never available and selects the fallback
+        uring_reader ring(vm.count("no-uring") ? 0 : 256);
+        size_t batchSize = ring.available() ? ring.capacity() : opt.BatchSize;
+
+        size_t next = 0;
+        auto source = [&](file_batch &batch)
+        {
+            size_t last = std::min(paths.size(), next + batchSize);
+            batch.Paths.assign(paths.begin() + next, paths.begin() + last);
+            next = last;
+            if (ring.available())
+                ring.read_files(batch.Paths, MAX_URING_FILE, batch.Contents, batch.Failed);
+            else
+                batch.Failed.assign(batch.Paths.size(), true);
+            return !batch.Paths.empty();
+        };
+
+        run_pipeline<file_batch>(opt, source, [&](unsigned w, file_batch &batch)
+        {
+            column_batch ciphertexts;
+            for (size_t i = 0; i < batch.Paths.size(); ++i)
+            {
+                mpz_rational x;
+                rational_init(x);
+                ciphertexts.push_back(x);
+                nlohmann::json j = nlohmann::json::parse(batch.Failed[i] ? read_file(batch.Paths[i]) : batch.Contents[i]);
+                ciphertext_from_json(j, ciphertexts[i]);
+            }
+            aggregate_fold(partial[w], ciphertexts.begin(), ciphertexts.end(), N);
+        });
+
+        for (size_t i = 1; i < partial.size(); ++i)
+            aggregate_merge(partial[0], partial[i], N);
+        partial[0].Key = key_fingerprint(N);
+
+        write_json(vm["output"].as<std::string>(), aggregate_to_json(partial[0]));
+
+        // cleanup
+        for (auto &a : partial)
+            aggregate_clear(a);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
@@ -1,7 +1,27 @@
 /*
  *  ahefutil encrypt -o cipher.json -p private_keys.json -v 5000
+ *  ahefutil encrypt -o column.txt -p private_keys.json -i values.txt -t 4
+ *  ahefutil encrypt -o amount.col -p private_keys.json --csv sales.csv -c amount --rowId order_id
  *
  *  Encrypts given rationalValue and writes ciphertext c = fmod((x_n/x_d)^(rx*(p-1)+1),p*q) to file.
+ *
+ *  With -i every line of the input file holds one value and the ciphertexts are
+ *  written as a ciphertext column. Since all values share e and N, the batch is
+ *  encrypted with the multi-buffer kernels of mb_powm.hpp (--kernel selects one,
+ *  --validate checks every ciphertext against the gcry_mpi_powm path). The
+ *  exponent is reduced mod p-1 and q-1 and recoded once per key (encryption_key.hpp);
+ *  --stats prints the resulting multiplications per encryption.
+ *
+ *  --csv reads one column of a CSV file (-c, by header name or 1-based index)
+ *  and writes a keyed column "row_id numerator denominator", the row id taken
+ *  from --rowId or else the record number. The file is mapped and cut into
+ *  chunks of whole records (csv.hpp), which the workers parse and encrypt, so
+ *  parsing scales with the threads and never holds up the exponentiations.
+ *
+ *  --packed "v1,v2,.." (or -i with --lanes k, k integers per ciphertext and a
+ *  multiple of k in the file) packs signed integers into laneBits-bit lanes of
+ *  one plaintext (see ahef_gmp.hpp); decrypt --lanes k --laneBits b unpacks
+ *  them again.
  *  
  */
 
@@ -10,6 +30,7 @@
 #include <stdlib.h>
 #include <gcrypt.h>
 #include <fstream>
+#include <sstream>
 #include <cmath>
 #include <limits>
 #include <algorithm>
@@ -17,8 +38,15 @@
 #include "json.hpp"
 #include "boost/program_options.hpp" 
 #include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <mutex>
 
 #include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "encryption_key.hpp"
+#include "pipeline.hpp"
+#include "csv.hpp"
 
 
 namespace 
@@ -50,6 +78,21 @@ static std::string toString ( gcry_mpi_t a)
     return std_string;
 }
 
+// the gcry_mpi_t of an mpz, for output in the format of toString
+static gcry_mpi_t to_gcry (const mpz_t a)
+{
+    mpz_t abs;
+    mpz_init(abs);
+    mpz_abs(abs, a);
+    gcry_mpi_t r = nullptr;
+    size_t scanned;
+    gcry_mpi_scan(&r, GCRYMPI_FMT_HEX, to_hex(abs).c_str(), 0, &scanned);
+    if (mpz_sgn(a) < 0)
+        gcry_mpi_neg(r, r);
+    mpz_clear(abs);
+    return r;
+}
+
 
 static void grcy_mpi_smod (gcry_mpi_t a, gcry_mpi_t p)
 {
@@ -72,31 +115,9 @@ struct grcy_mpi_rational
 };
 
 
-// calculate ciphertext: c = fmod((x_n/x_d)^(rx*(p-1)+1),p*q)
-static grcy_mpi_rational encrypt (double value, gcry_mpi_t p, gcry_mpi_t q)
+// calculate ciphertext: c = fmod((x_n/x_d)^(rx*(p-1)+1),p*q) for HEX x_n and x_d
+static grcy_mpi_rational encrypt (const char *v_n, const char *v_d, gcry_mpi_t p, gcry_mpi_t q)
 {
-    // get fractional approximation value = numerator/denominator
-    mpf_set_default_prec (1024);
-    
-    mpf_t V;
-    mpf_init(V);
-    mpf_set_d(V,value);
-    
-    mpq_t fractional;
-    mpq_init (fractional);
-    mpq_set_f(fractional,V);
-    mpq_canonicalize(fractional);
-    
-    mpz_t numerator, denominator;
-    mpz_init(numerator);
-    mpz_init(denominator);
-    mpq_get_num(numerator, fractional);
-    mpq_get_den(denominator, fractional);
-    
-    char *v_n, *v_d;
-    gmp_asprintf (&v_n, "%Zx", numerator);
-    gmp_asprintf (&v_d, "%Zx", denominator);        
-    
     // calculate N=p*q
     gcry_mpi_t N = gcry_mpi_new(gcry_mpi_get_nbits(p)+gcry_mpi_get_nbits(q));
     gcry_mpi_mul (N, p, q);
@@ -146,7 +167,419 @@ static grcy_mpi_rational encrypt (double value, gcry_mpi_t p, gcry_mpi_t q)
     return cipher;
 }
 
+static grcy_mpi_rational encrypt (double value, gcry_mpi_t p, gcry_mpi_t q)
+{
+    // get fractional approximation value = numerator/denominator
+    mpf_set_default_prec (1024);
+    
+    mpf_t V;
+    mpf_init(V);
+    mpf_set_d(V,value);
+    
+    mpq_t fractional;
+    mpq_init (fractional);
+    mpq_set_f(fractional,V);
+    mpq_canonicalize(fractional);
+    
+    mpz_t numerator, denominator;
+    mpz_init(numerator);
+    mpz_init(denominator);
+    mpq_get_num(numerator, fractional);
+    mpq_get_den(denominator, fractional);
+    
+    char *v_n, *v_d;
+    gmp_asprintf (&v_n, "%Zx", numerator);
+    gmp_asprintf (&v_d, "%Zx", denominator);        
+    
+    struct grcy_mpi_rational cipher = encrypt (v_n, v_d, p, q);
+
+    void (*freefunc)(void *, size_t);
+    mp_get_memory_functions (NULL, NULL, &freefunc);
+    freefunc (v_n, strlen(v_n) + 1);
+    freefunc (v_d, strlen(v_d) + 1);
+    mpz_clear(numerator);
+    mpz_clear(denominator);
+    mpq_clear(fractional);
+    mpf_clear(V);
+
+    return cipher;
+}
+
+
+
+
+// packing layout: Lanes integers of LaneBits bits per ciphertext, Lanes = 0 for none
+struct packing
+{
+    size_t Lanes;
+    unsigned LaneBits;
+};
+
+struct value_batch
+{
+    std::vector<double> Values;
+    std::vector<long long> Integers;    // Lanes per ciphertext when packing
+    column_batch Cipher;
+};
+
+static long long parse_integer (const std::string &s)
+{
+    size_t end;
+    long long v = std::stoll(s, &end);
+    if (s.find_first_not_of(" \t\r", end) != std::string::npos)
+        throw std::runtime_error("not an integer: " + s);
+    return v;
+}
+
+// a finite double; nan and inf have no rational to encrypt
+static double parse_value (const std::string &s)
+{
+    size_t end;
+    double v = std::stod(s, &end);
+    if (!std::isfinite(v) || s.find_first_not_of(" \t\r", end) != std::string::npos)
+        throw std::runtime_error("not a number: " + s);
+    return v;
+}
+
+// "12,-3,7" or "12 -3 7"
+static std::vector<long long> parse_integer_list (const std::string &list)
+{
+    std::vector<long long> out;
+    std::string token;
+    std::istringstream iss(list);
+    while (std::getline(iss, token, ','))
+    {
+        std::istringstream words(token);
+        std::string word;
+        while (words >> word)
+            out.push_back(parse_integer(word));
+    }
+    return out;
+}
+
+// reads batches of one value per line; when packing, every group of
+// pack.Lanes integers is one ciphertext, and the input must fill the last one,
+// since zero padding could not be told apart from real zeros after decryption
+class value_source
+{
+public:
+    value_source (const std::string &path, size_t batchSize, const packing &pack)
+        : ifs_(path), path_(path), batchSize_(batchSize), pack_(pack), line_(0), values_(0)
+    {
+        if (!ifs_)
+            throw std::runtime_error("cannot open " + path);
+    }
+
+    bool operator() (value_batch &batch)
+    {
+        std::vector<long long> &integers = batch.Integers;
+        size_t limit = pack_.Lanes ? batchSize_ * pack_.Lanes : batchSize_;
+        std::string line;
+        while ((pack_.Lanes ? integers.size() : batch.Values.size()) < limit && std::getline(ifs_, line))
+        {
+            ++line_;
+            size_t begin = line.find_first_not_of(" \t\r");
+            if (begin == std::string::npos || line[begin] == '#')
+                continue;
+            try
+            {
+                if (pack_.Lanes)
+                    integers.push_back(parse_integer(line.substr(begin)));
+                else
+                    batch.Values.push_back(parse_value(line.substr(begin)));
+            }
+            catch (std::exception &)
+            {
+                throw std::runtime_error("line " + std::to_string(line_) + " of " + path_ + ": not a number: " + line);
+            }
+        }
+        if (pack_.Lanes)
+        {
+            values_ += integers.size();
+            if (integers.size() % pack_.Lanes)
+                throw std::runtime_error(path_ + " holds " + std::to_string(values_) + " integers, not a multiple of " +
+                                         std::to_string(pack_.Lanes) + " lanes");
+            batch.Values.assign(integers.size() / pack_.Lanes, 0);
+        }
+        return !batch.Values.empty();
+    }
+
+private:
+    std::ifstream ifs_;
+    std::string path_;
+    size_t batchSize_;
+    packing pack_;
+    size_t line_;
+    size_t values_;         // integers read so far, when packing
+};
+
+// the per-key context of p and q
+static encryption_key *make_key (gcry_mpi_t p, gcry_mpi_t q, mb_powm_context::kernel_kind kernel)
+{
+    mpz_t P, Q;
+    mpz_init(P);
+    mpz_init(Q);
+    set_hex(P, toString(p));
+    set_hex(Q, toString(q));
+    encryption_key *key = new encryption_key(P, Q, kernel);
+    mpz_clear(P);
+    mpz_clear(Q);
+    return key;
+}
+
+// encrypt the values of a batch into batch.Cipher
+static void encrypt_batch (value_batch &batch, gcry_mpi_t p, gcry_mpi_t q, const encryption_key &key,
+                           const packing &pack, bool validate)
+{
+    size_t n = batch.Values.size();
+    std::vector<bool> negative(n);
+    std::vector<mpz_ptr> bases;
+    for (size_t i = 0; i < n; ++i)
+    {
+        mpz_rational c;
+        rational_init_one(c);
+        batch.Cipher.push_back(c);
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        mpz_rational &x = batch.Cipher[i];
+
+        // a packed plaintext has denominator 1 = 1^e, only its numerator is exponentiated
+        if (pack.Lanes)
+            pack_lanes(x.Numerator, &batch.Integers[i * pack.Lanes], pack.Lanes, pack.LaneBits);
+        else
+            rational_from_double(x.Numerator, x.Denominator, batch.Values[i]);
+        negative[i] = mpz_sgn(x.Numerator) < 0;
+        mpz_abs(x.Numerator, x.Numerator);
+        bases.push_back(x.Numerator);
+        if (!pack.Lanes)
+            bases.push_back(x.Denominator);
+    }
+
+    // smod((x_n)^e, N) and smod((x_d)^e, N) for the whole batch
+    std::vector<mpz_srcptr> in(bases.begin(), bases.end());
+    key.powm(bases.data(), in.data(), bases.size());
+    for (size_t i = 0; i < n; ++i)
+        if (negative[i])
+            mpz_neg(batch.Cipher[i].Numerator, batch.Cipher[i].Numerator);
+
+    if (!validate)
+        return;
+
+    // encrypt() sets the global mpf precision, so reference runs are serialized
+    static std::mutex referenceMutex;
+    std::lock_guard<std::mutex> lock(referenceMutex);
+
+    mpz_t t;
+    mpz_init(t);
+    for (size_t i = 0; i < n; ++i)
+    {
+        grcy_mpi_rational reference;
+        if (pack.Lanes)
+        {
+            pack_lanes(t, &batch.Integers[i * pack.Lanes], pack.Lanes, pack.LaneBits);
+            reference = encrypt(to_hex(t).c_str(), "1", p, q);
+        }
+        else
+        {
+            reference = encrypt(batch.Values[i], p, q);
+        }
+        set_hex(t, toString(reference.Numerator));
+        bool same = mpz_cmp(t, batch.Cipher[i].Numerator) == 0;
+        set_hex(t, toString(reference.Denominator));
+        same = same && mpz_cmp(t, batch.Cipher[i].Denominator) == 0;
+        gcry_mpi_release(reference.Numerator);
+        gcry_mpi_release(reference.Denominator);
+        if (!same)
+        {
+            mpz_clear(t);
+            throw std::runtime_error("kernel " + std::string(mb_powm_context::kernel_name(key.kernel())) +
+                                     " differs from gcry_mpi_powm for value " + std::to_string(batch.Values[i]));
+        }
+    }
+    mpz_clear(t);
+}
+
+// encrypt all values of the input file into a ciphertext column
+static void encrypt_column (const std::string &inFile, const std::string &outFile, gcry_mpi_t p, gcry_mpi_t q,
+                            const encryption_key &key, const packing &pack, bool validate, unsigned threads)
+{
+    pipeline_options opt = default_pipeline_options(threads);
+    opt.BatchSize = std::max<size_t>(opt.BatchSize, 4 * key.lanes());
+    value_source source(inFile, opt.BatchSize, pack);
+    column_sink sink(outFile);
+
+    try
+    {
+        run_pipeline<value_batch>(opt, source, [&](unsigned, value_batch &batch)
+        {
+            encrypt_batch(batch, p, q, key, pack, validate);
+        },
+        [&](value_batch &batch)
+        {
+            sink(batch.Cipher);
+        });
+    }
+    catch (...)
+    {
+        // no partial column is left behind
+        sink.close();
+        unlink(outFile.c_str());
+        throw;
+    }
+    sink.close();
+}
+
+// which CSV fields become the values and row ids of the ciphertext column
+struct csv_options
+{
+    std::string Column;     // header name or 1-based index
+    std::string RowId;      // likewise; empty: number the records from 1
+    bool Header;            // the first record names the columns
+    char Delimiter;
+};
+
+// whole records [First, Last) of the file, parsed and encrypted by one worker
+struct csv_batch
+{
+    size_t First;
+    size_t Last;
+    std::vector<std::string> RowIds;
+    value_batch Values;
+    std::string Error;      // first bad record, reported by the writer in file order
+};
+
+static double parse_csv_value (const std::string &field)
+{
+    const char *begin = field.c_str();
+    char *end;
+    double v = strtod(begin, &end);
+    if (end == begin || field.find_first_not_of(" \t", end - begin) != std::string::npos || !std::isfinite(v))
+        throw std::runtime_error("not a number: \"" + field + "\"");
+    return v;
+}
+
+// encrypt one column of a CSV file into a keyed ciphertext column
+// ("row_id numerator denominator"); the records are parsed by the workers
+static void encrypt_csv (const std::string &csvFile, const std::string &outFile, const csv_options &csv,
+                         gcry_mpi_t p, gcry_mpi_t q, const encryption_key &key, bool validate, unsigned threads)
+{
+    pipeline_options opt = default_pipeline_options(threads);
+    opt.BatchSize = std::max<size_t>(opt.BatchSize, 4 * key.lanes());
+
+    csv_file file(csvFile);
+    const char *data = file.data();
+    const char *end = data + file.size();
+    const char *body = data;
+    if (file.size() >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        body += 3;
 
+    csv_record header;
+    if (csv.Header)
+        body = csv_parse_record(body, end, csv.Delimiter, header);
+    long column = csv_column_index(csv.Column, csv.Header ? &header : nullptr);
+    if (column < 0)
+        throw std::runtime_error("no CSV column " + csv.Column);
+    long rowId = csv.RowId.empty() ? -1 : csv_column_index(csv.RowId, csv.Header ? &header : nullptr);
+    if (!csv.RowId.empty() && rowId < 0)
+        throw std::runtime_error("no CSV column " + csv.RowId);
+    size_t needed = size_t(std::max(column, rowId)) + 1;
+
+    // chunks of about one batch of records, judging by the first records
+    csv_record record;
+    const char *sample = body;
+    size_t sampled = 0;
+    for (; sampled < 64 && sample < end; ++sampled)
+        sample = csv_parse_record(sample, end, csv.Delimiter, record);
+    size_t recordBytes = sampled ? (sample - body + sampled - 1) / sampled : 1;
+    size_t chunk = std::max(recordBytes * opt.BatchSize, size_t(end - body) / (1 << 20) + 1);
+    std::vector<std::pair<size_t, size_t>> ranges = csv_split(data, body - data, file.size(), chunk, opt.Threads);
+
+    std::vector<csv_record> records(opt.Threads);
+    size_t next = 0;
+    size_t rows = 0;
+    std::ofstream ofs(outFile, std::ofstream::out);
+    if (!ofs)
+        throw std::runtime_error("cannot write " + outFile);
+
+    try
+    {
+        run_pipeline<csv_batch>(opt, [&](csv_batch &batch)
+        {
+            if (next == ranges.size())
+                return false;
+            batch.First = ranges[next].first;
+            batch.Last = ranges[next].second;
+            ++next;
+            return true;
+        },
+        [&](unsigned w, csv_batch &batch)
+        {
+            csv_record &r = records[w];
+            const char *pos = data + batch.First;
+            while (pos < data + batch.Last)
+            {
+                pos = csv_parse_record(pos, data + batch.Last, csv.Delimiter, r);
+                if (r.blank())
+                    continue;
+
+                // only the writer knows the record number, so stop here and leave it the message
+                std::string id = rowId >= 0 && size_t(rowId) < r.Size ? r.Fields[rowId] : "";
+                if (r.Size < needed)
+                    batch.Error = std::to_string(r.Size) + " fields, column " + std::to_string(needed) + " required";
+                else if (rowId >= 0 && (id.empty() || id.find_first_of(" \t\r\n") != std::string::npos))
+                    batch.Error = "row id \"" + id + "\" is empty or contains whitespace";
+                else
+                {
+                    try
+                    {
+                        batch.Values.Values.push_back(parse_csv_value(r.Fields[column]));
+                    }
+                    catch (std::runtime_error &e)
+                    {
+                        batch.Error = e.what();
+                    }
+                }
+                if (!batch.Error.empty())
+                {
+                    if (!id.empty())
+                        batch.Error = "row id " + id + ": " + batch.Error;
+                    break;
+                }
+                if (rowId >= 0)
+                    batch.RowIds.push_back(id);
+            }
+            if (batch.Error.empty())
+                encrypt_batch(batch.Values, p, q, key, packing{0, 0}, validate);
+        },
+        [&](csv_batch &batch)
+        {
+            if (!batch.Error.empty())
+                throw std::runtime_error("CSV record " + std::to_string(rows + batch.Values.Values.size() + 1) + ": " +
+                                         batch.Error);
+            std::string out;
+            const column_batch &cipher = batch.Values.Cipher;
+            for (size_t i = 0; i < cipher.size(); ++i)
+            {
+                ++rows;
+                out += format_keyed_column_line(rowId >= 0 ? batch.RowIds[i] : std::to_string(rows), cipher[i]);
+                out += '\n';
+            }
+            ofs << out;
+        });
+    }
+    catch (...)
+    {
+        // no partial column is left behind
+        ofs.close();
+        unlink(outFile.c_str());
+        throw;
+    }
+
+    ofs.close();
+    if (!ofs)
+        throw std::runtime_error("cannot write " + outFile);
+}
 
 
 int main(int argc, char** argv)
@@ -157,9 +590,22 @@ int main(int argc, char** argv)
         po::options_description description("Usage");
         description.add_options()
             ("help,h", "Display this help message") 
-            ("outputFile,o", po::value<std::string>()->required(), "Output file containing generated private keys.")
+            ("outputFile,o", po::value<std::string>(), "Output file containing generated private keys.")
             ("privateKeys,p", po::value<std::string>()->required(), "Private key file.")
-            ("value,v", po::value<double>()->required(), "Rational number to encrypt.");
+            ("value,v", po::value<double>(), "Rational number to encrypt.")
+            ("input,i", po::value<std::string>(), "File with one rational number per line, encrypted into a ciphertext column.")
+            ("csv", po::value<std::string>(), "CSV file whose --column is encrypted into a keyed ciphertext column.")
+            ("column,c", po::value<std::string>(), "With --csv, the column to encrypt: header name or 1-based index.")
+            ("rowId", po::value<std::string>(), "With --csv, the column of row ids (name or index); default: the record number.")
+            ("header", "With --csv, the first record names the columns (implied by a column name).")
+            ("delimiter", po::value<char>()->default_value(','), "With --csv, the field delimiter.")
+            ("packed", po::value<std::string>(), "Integers packed into the lanes of one ciphertext, e.g. \"12,-3,7\".")
+            ("lanes", po::value<size_t>()->default_value(0), "With -i, pack this many integers (one per line) into each ciphertext.")
+            ("laneBits", po::value<unsigned>()->default_value(64), "Bits per packed lane, sign and guard bits included.")
+            ("kernel,k", po::value<std::string>()->default_value("auto"), "Exponentiation kernel: auto, scalar, avx2 or avx512ifma.")
+            ("validate", "With -i, --csv or -v, check every ciphertext against gcry_mpi_powm.")
+            ("stats", "Print the exponentiation schedules of the key and the multiplications per encryption.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads (with -i or --csv).");
            
         po::variables_map vm;
         
@@ -174,6 +620,20 @@ int main(int argc, char** argv)
             }
             
             po::notify(vm);    
+
+            size_t inputs = vm.count("value") + vm.count("input") + vm.count("csv") + vm.count("packed");
+            if (inputs > 1 || (inputs == 0 && !vm.count("stats")))
+                throw po::error("exactly one of --value, --input, --csv or --packed is required");
+            if (vm.count("csv") != vm.count("column"))
+                throw po::error("--csv and --column go together");
+            if (vm.count("csv") && vm["lanes"].as<size_t>() > 0)
+                throw po::error("--lanes does not apply to --csv");
+            if (vm.count("value") && !std::isfinite(vm["value"].as<double>()))
+                throw po::error("--value must be a finite number");
+            if (vm["laneBits"].as<unsigned>() < 2)
+                throw po::error("--laneBits must be at least 2");
+            if (inputs == 1 && !vm.count("outputFile"))
+                throw po::error("the option '--outputFile' is required but missing");
         }
         catch(po::error& e) 
         { 
@@ -206,9 +666,65 @@ int main(int argc, char** argv)
         q = gcry_mpi_new(0);
         gcry_mpi_scan(&p, GCRYMPI_FMT_HEX, pString.c_str(), 0, &scanned);
         gcry_mpi_scan(&q, GCRYMPI_FMT_HEX, qString.c_str(), 0, &scanned);
-        
 
-        grcy_mpi_rational cipher = encrypt (vm["value"].as<double>(), p, q);
+        // packing layout, checked against the plaintext space mod p
+        packing pack;
+        pack.Lanes = vm["lanes"].as<size_t>();
+        pack.LaneBits = vm["laneBits"].as<unsigned>();
+        std::vector<long long> packed;
+        if (vm.count("packed"))
+        {
+            packed = parse_integer_list(vm["packed"].as<std::string>());
+            pack.Lanes = packed.size();
+        }
+        mpz_t P;
+        mpz_init(P);
+        set_hex(P, pString);
+        size_t maxLanes = max_lanes(P, pack.LaneBits);
+        mpz_clear(P);
+        if (pack.Lanes > maxLanes)
+            throw std::runtime_error("at most " + std::to_string(maxLanes) + " lanes of " +
+                                     std::to_string(pack.LaneBits) + " bits fit into the plaintext space");
+
+        std::unique_ptr<encryption_key> key(make_key(p, q, mb_powm_context::parse_kernel(vm["kernel"].as<std::string>())));
+        if (vm.count("stats"))
+            key->print_stats(std::cout);
+        if (vm.count("input"))
+            encrypt_column(vm["input"].as<std::string>(), vm["outputFile"].as<std::string>(), p, q,
+                           *key, pack, vm.count("validate") > 0, vm["threads"].as<unsigned>());
+        if (vm.count("csv"))
+        {
+            csv_options csv;
+            csv.Column = vm["column"].as<std::string>();
+            csv.RowId = vm.count("rowId") ? vm["rowId"].as<std::string>() : "";
+            csv.Header = vm.count("header") || csv_column_index(csv.Column, nullptr) < 0 ||
+                         (!csv.RowId.empty() && csv_column_index(csv.RowId, nullptr) < 0);
+            csv.Delimiter = vm["delimiter"].as<char>();
+            encrypt_csv(vm["csv"].as<std::string>(), vm["outputFile"].as<std::string>(), csv, p, q,
+                        *key, vm.count("validate") > 0, vm["threads"].as<unsigned>());
+        }
+        if (!vm.count("value") && !vm.count("packed"))
+        {
+            gcry_mpi_release(p);
+            gcry_mpi_release(q);
+            return SUCCESS;
+        }
+
+        // a single value is a batch of one, through the per-key context as well
+        value_batch batch;
+        if (vm.count("packed"))
+        {
+            batch.Integers = packed;
+            batch.Values.assign(1, 0);
+        }
+        else
+        {
+            batch.Values.assign(1, vm["value"].as<double>());
+        }
+        encrypt_batch(batch, p, q, *key, pack, vm.count("validate") > 0);
+        grcy_mpi_rational cipher;
+        cipher.Numerator = to_gcry(batch.Cipher[0].Numerator);
+        cipher.Denominator = to_gcry(batch.Cipher[0].Denominator);
 
 
         // write ciphertext to output file
@@ -226,6 +742,8 @@ int main(int argc, char** argv)
         ofs.close();
         
         // cleanup
+        gcry_mpi_release(cipher.Numerator);
+        gcry_mpi_release(cipher.Denominator);
         gcry_mpi_release(p);
         gcry_mpi_release(q);
     }
@@ -0,0 +1,171 @@
+/*
+ *  Per-key encryption context: everything about the fixed exponent
+ *  e = rx*(p-1)+1 that can be computed once per key instead of once per value.
+ *
+ *  Holding the private factors, b^e mod N is computed through the CRT:
+ *
+ *      b^e mod p = (b mod p)^ep mod p,   ep = ((e-1) mod (p-1)) + 1
+ *      b^e mod q = (b mod q)^eq mod q,   eq = ((e-1) mod (q-1)) + 1
+ *      b^e mod N = rq + q * ((rp - rq) * q^-1 mod p)
+ *
+ *  The reduced exponents lie in [1, p-1] and [1, q-1], so they agree with e
+ *  by Fermat also for bases divisible by p or q, and the result is identical
+ *  to gcry_mpi_powm(b, e, N). With rx=1, ep = 1 and only the half-size
+ *  exponentiation mod q remains. Both exponents are recoded once, in their
+ *  mb_powm_context, into the sliding-window schedule the SIMD kernels run;
+ *  the scalar kernel hands the reduced exponents to mpz_powm.
+ */
+
+#ifndef AHEF_ENCRYPTION_KEY_HPP
+#define AHEF_ENCRYPTION_KEY_HPP
+
+#include <stdio.h>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <gmp.h>
+#include "mb_powm.hpp"
+
+
+class encryption_key
+{
+public:
+    encryption_key (const mpz_t p, const mpz_t q, mb_powm_context::kernel_kind kernel = mb_powm_context::best_kernel())
+    {
+        mpz_init_set(p_, p);
+        mpz_init_set(q_, q);
+        mpz_init(N_);
+        mpz_mul(N_, p, q);
+
+        // e = (rx*(p-1)+1) with rx=1
+        mpz_init(e_);
+        mpz_sub_ui(e_, p, 1);
+        mpz_add_ui(e_, e_, 1);
+
+        mpz_init(qInv_);
+        mpz_invert(qInv_, q, p);
+
+        mpz_t ep, eq;
+        mpz_init(ep);
+        mpz_init(eq);
+        reduce_exponent(ep, p);
+        reduce_exponent(eq, q);
+        modP_.reset(new mb_powm_context(ep, p, kernel));
+        modQ_.reset(new mb_powm_context(eq, q, kernel));
+        mpz_clear(ep);
+        mpz_clear(eq);
+    }
+
+    ~encryption_key ()
+    {
+        mpz_clear(p_);
+        mpz_clear(q_);
+        mpz_clear(N_);
+        mpz_clear(e_);
+        mpz_clear(qInv_);
+    }
+
+    encryption_key (const encryption_key &) = delete;
+    encryption_key &operator= (const encryption_key &) = delete;
+
+    mpz_srcptr N () const { return N_; }
+    mpz_srcptr e () const { return e_; }
+    mb_powm_context::kernel_kind kernel () const { return modQ_->kernel(); }
+    unsigned lanes () const { return modQ_->lanes(); }
+
+    // r[i] = b[i]^e mod N for 0 <= b[i]; r[i] must be initialized and may alias b[i]
+    void powm (mpz_ptr *r, mpz_srcptr *b, size_t count) const
+    {
+        std::unique_ptr<mpz_t[]> rp(new mpz_t[count]), rq(new mpz_t[count]);
+        std::vector<mpz_ptr> outP(count), outQ(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            mpz_init(rp[i]);
+            mpz_init(rq[i]);
+            mpz_mod(rp[i], b[i], p_);
+            mpz_mod(rq[i], b[i], q_);
+            outP[i] = rp[i];
+            outQ[i] = rq[i];
+        }
+
+        std::vector<mpz_srcptr> inP(outP.begin(), outP.end()), inQ(outQ.begin(), outQ.end());
+        modP_->powm(outP.data(), inP.data(), count);
+        modQ_->powm(outQ.data(), inQ.data(), count);
+
+        // r = rq + q * ((rp - rq) * q^-1 mod p)
+        for (size_t i = 0; i < count; ++i)
+        {
+            mpz_sub(rp[i], rp[i], rq[i]);
+            mpz_mul(rp[i], rp[i], qInv_);
+            mpz_mod(rp[i], rp[i], p_);
+            mpz_mul(r[i], rp[i], q_);
+            mpz_add(r[i], r[i], rq[i]);
+            mpz_clear(rp[i]);
+            mpz_clear(rq[i]);
+        }
+    }
+
+    // multiplications per exponentiation: plain square-and-multiply and the
+    // sliding window on e mod N, against the work of the selected kernel mod p
+    // and q; the schedules are only executed by the SIMD kernels
+    void print_stats (std::ostream &os) const
+    {
+        bool simd = kernel() != mb_powm_context::KERNEL_SCALAR;
+        exponent_schedule binary = exponent_schedule::sliding(e_, 1);
+        exponent_schedule full = exponent_schedule::optimal(e_);
+        os << "kernel: " << mb_powm_context::kernel_name(kernel()) << std::endl;
+        os << "exponent       modulus bits  exponent bits  window  multiplications" << std::endl;
+        print_row(os, "e (binary)", N_, binary, true);
+        print_row(os, "e", N_, full, true);
+        print_row(os, "e mod (p-1)", p_, modP_->schedule(), simd);
+        print_row(os, "e mod (q-1)", q_, modQ_->schedule(), simd);
+
+        os << "per encryption: " << binary.multiplications() << " multiplications mod N (square-and-multiply), "
+           << full.multiplications() << " (sliding window), ";
+        if (simd)
+        {
+            // a product of half-size numbers costs about a quarter of a full-size one
+            size_t crt = modP_->schedule().multiplications() + modQ_->schedule().multiplications();
+            os << crt << " mod p or q (CRT, about " << (crt + 3) / 4 << " mod N)" << std::endl;
+        }
+        else
+        {
+            // mpz_powm beats running the schedule on mpz, and recodes the exponent itself
+            os << "one mpz_powm mod p and one mod q (CRT, exponents of " << modP_->schedule().bits()
+               << " and " << modQ_->schedule().bits() << " bits)" << std::endl;
+        }
+    }
+
+private:
+    // ((e-1) mod (m-1)) + 1
+    void reduce_exponent (mpz_t r, const mpz_t m) const
+    {
+        mpz_t m1;
+        mpz_init(m1);
+        mpz_sub_ui(m1, m, 1);
+        mpz_sub_ui(r, e_, 1);
+        mpz_mod(r, r, m1);
+        mpz_add_ui(r, r, 1);
+        mpz_clear(m1);
+    }
+
+    // window and multiplications only for a schedule that is executed
+    static void print_row (std::ostream &os, const char *name, mpz_srcptr m, const exponent_schedule &s, bool run)
+    {
+        char line[128];
+        if (run)
+            snprintf(line, sizeof(line), "%-14s %12zu  %13zu  %6u  %15zu", name, mpz_sizeinbase(m, 2), s.bits(),
+                     s.Window, s.multiplications());
+        else
+            snprintf(line, sizeof(line), "%-14s %12zu  %13zu  %6s  %15s", name, mpz_sizeinbase(m, 2), s.bits(),
+                     "-", "mpz_powm");
+        os << line << std::endl;
+    }
+
+    mpz_t p_, q_, N_, e_, qInv_;
+    std::unique_ptr<mb_powm_context> modP_, modQ_;
+};
+
+#endif // AHEF_ENCRYPTION_KEY_HPP
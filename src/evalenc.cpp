@@ -0,0 +1,562 @@
+/*
+ *  ahefutil eval -p public_key.json -c A=a.enc -c B=b.enc -c C=c.enc -c D=d.enc -o r.enc '(A + B) * C - D'
+ *  ahefutil eval -p public_key.json -C X=x.col -C Y=y.col -c M=mean.enc -o r.col '(X - M) * (Y - M)' -t 8
+ *
+ *  Evaluate an arithmetic expression over named ciphertexts in memory and write
+ *  only its value, in place of a chain of addenc, subenc and mulenc calls with
+ *  an intermediate file per step. The expression has +, -, * (usual precedence,
+ *  left associative), unary minus, parentheses, names bound with -c NAME=FILE
+ *  (a ciphertext) or -C NAME=FILE (a ciphertext column) and plaintext numbers,
+ *  which combine with ciphertexts without being encrypted, as in scalenc.
+ *
+ *  Every operand file is read once, however often its name appears. With any
+ *  column operand the expression is evaluated row by row over the aligned
+ *  columns (ciphertext operands apply to every row) and the result is a
+ *  column. The expression is compiled to straight-line code first: equal
+ *  subexpressions are computed once and a product that is only added to
+ *  something else becomes one fma_rational (see fmaenc).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+enum expr_op { EXPR_NAME, EXPR_NUMBER, EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_NEG, EXPR_FMA };
+
+// a node of the parsed expression; Left and Right index the node vector
+struct expr_node
+{
+    expr_op Op;
+    std::string Name;       // EXPR_NAME
+    double Value;           // EXPR_NUMBER
+    size_t Left;
+    size_t Right;
+};
+
+// recursive descent over
+//     expression := term (('+' | '-') term)*
+//     term       := unary ('*' unary)*
+//     unary      := '-' unary | '(' expression ')' | name | number
+class expr_parser
+{
+public:
+    expr_parser (const std::string &text, std::vector<expr_node> &nodes) : text_(text), pos_(0), nodes_(nodes) {}
+
+    // parse the whole text; returns the root node
+    size_t parse ()
+    {
+        size_t root = expression();
+        if (peek() != '\0')
+            fail("unexpected '" + std::string(1, text_[pos_]) + "'");
+        return root;
+    }
+
+private:
+    size_t expression ()
+    {
+        size_t left = term();
+        for (char c = peek(); c == '+' || c == '-'; c = peek())
+        {
+            ++pos_;
+            left = add(c == '+' ? EXPR_ADD : EXPR_SUB, left, term());
+        }
+        return left;
+    }
+
+    size_t term ()
+    {
+        size_t left = unary();
+        while (peek() == '*')
+        {
+            ++pos_;
+            left = add(EXPR_MUL, left, unary());
+        }
+        return left;
+    }
+
+    size_t unary ()
+    {
+        char c = peek();
+        if (c == '-')
+        {
+            ++pos_;
+            return add(EXPR_NEG, unary(), 0);
+        }
+        if (c == '(')
+        {
+            ++pos_;
+            size_t inner = expression();
+            if (peek() != ')')
+                fail("expected ')'");
+            ++pos_;
+            return inner;
+        }
+        if (isalpha((unsigned char) c) || c == '_')
+        {
+            size_t first = pos_;
+            while (pos_ < text_.size() && (isalnum((unsigned char) text_[pos_]) || text_[pos_] == '_'))
+                ++pos_;
+            expr_node node = { EXPR_NAME, text_.substr(first, pos_ - first), 0.0, 0, 0 };
+            nodes_.push_back(node);
+            return nodes_.size() - 1;
+        }
+        if (isdigit((unsigned char) c) || c == '.')
+        {
+            const char *first = text_.c_str() + pos_;
+            char *last;
+            double value = strtod(first, &last);
+            if (last == first)
+                fail("malformed number");
+            pos_ += last - first;
+            expr_node node = { EXPR_NUMBER, "", value, 0, 0 };
+            nodes_.push_back(node);
+            return nodes_.size() - 1;
+        }
+        fail(c == '\0' ? "unexpected end of expression" : "unexpected '" + std::string(1, c) + "'");
+        return 0;
+    }
+
+    size_t add (expr_op op, size_t left, size_t right)
+    {
+        expr_node node = { op, "", 0.0, left, right };
+        nodes_.push_back(node);
+        return nodes_.size() - 1;
+    }
+
+    // next non-blank character, or '\0' at the end
+    char peek ()
+    {
+        while (pos_ < text_.size() && isspace((unsigned char) text_[pos_]))
+            ++pos_;
+        return pos_ < text_.size() ? text_[pos_] : '\0';
+    }
+
+    void fail (const std::string &what)
+    {
+        throw std::runtime_error("expression, column " + std::to_string(pos_ + 1) + ": " + what);
+    }
+
+    const std::string &text_;
+    size_t pos_;
+    std::vector<expr_node> &nodes_;
+};
+
+
+// one operation of the compiled program; Args and Slot index the value slots
+struct expr_step
+{
+    expr_op Op;
+    size_t Args[3];
+    size_t Slot;
+};
+
+// an expression as straight-line code over value slots: the named operands come
+// first (in order of first use), then the plaintext numbers, then one slot per step
+struct expr_program
+{
+    std::vector<std::string> Names;
+    std::vector<double> Numbers;
+    std::vector<expr_step> Steps;
+    size_t Slots;
+    size_t Result;
+    size_t Merged;          // repeated subexpressions computed once
+    size_t Fused;           // products folded into a following addition
+};
+
+class expr_compiler
+{
+public:
+    expr_compiler (const std::vector<expr_node> &nodes, expr_program &program) : nodes_(nodes), program_(program) {}
+
+    void compile (size_t root)
+    {
+        program_.Names.clear();
+        program_.Numbers.clear();
+        program_.Steps.clear();
+        program_.Merged = 0;
+        program_.Fused = 0;
+
+        collect(root);
+        program_.Slots = program_.Names.size() + program_.Numbers.size();
+        program_.Result = emit(root);
+        fuse();
+    }
+
+private:
+    // number the operands before any step
+    void collect (size_t k)
+    {
+        const expr_node &node = nodes_[k];
+        if (node.Op == EXPR_NAME && !names_.count(node.Name))
+        {
+            names_[node.Name] = program_.Names.size();
+            program_.Names.push_back(node.Name);
+        }
+        else if (node.Op == EXPR_NUMBER && !numbers_.count(node.Value))
+        {
+            numbers_[node.Value] = program_.Numbers.size();
+            program_.Numbers.push_back(node.Value);
+        }
+        else if (node.Op != EXPR_NAME && node.Op != EXPR_NUMBER)
+        {
+            collect(node.Left);
+            if (node.Op != EXPR_NEG)
+                collect(node.Right);
+        }
+    }
+
+    size_t emit (size_t k)
+    {
+        const expr_node &node = nodes_[k];
+        if (node.Op == EXPR_NAME)
+            return names_[node.Name];
+        if (node.Op == EXPR_NUMBER)
+            return program_.Names.size() + numbers_[node.Value];
+
+        size_t a = emit(node.Left);
+        size_t b = node.Op == EXPR_NEG ? 0 : emit(node.Right);
+        if ((node.Op == EXPR_ADD || node.Op == EXPR_MUL) && b < a)
+            std::swap(a, b);
+
+        auto key = std::make_tuple(node.Op, a, b);
+        auto seen = steps_.find(key);
+        if (seen != steps_.end())
+        {
+            ++program_.Merged;
+            return seen->second;
+        }
+
+        expr_step step = { node.Op, { a, b, 0 }, program_.Slots++ };
+        program_.Steps.push_back(step);
+        steps_[key] = step.Slot;
+        return step.Slot;
+    }
+
+    // x*y + z with x*y used nowhere else -> fma(x, y, z)
+    void fuse ()
+    {
+        std::vector<size_t> uses(program_.Slots, 0);
+        std::vector<size_t> producer(program_.Slots, program_.Steps.size());
+        for (size_t s = 0; s < program_.Steps.size(); ++s)
+        {
+            const expr_step &step = program_.Steps[s];
+            producer[step.Slot] = s;
+            uses[step.Args[0]]++;
+            if (step.Op != EXPR_NEG)
+                uses[step.Args[1]]++;
+        }
+        uses[program_.Result]++;
+
+        std::vector<bool> dead(program_.Steps.size(), false);
+        for (auto &step : program_.Steps)
+        {
+            if (step.Op != EXPR_ADD)
+                continue;
+            for (int side = 0; side < 2; ++side)
+            {
+                size_t p = producer[step.Args[side]];
+                if (p == program_.Steps.size() || dead[p] || program_.Steps[p].Op != EXPR_MUL ||
+                    uses[step.Args[side]] != 1)
+                    continue;
+                size_t z = step.Args[1 - side];
+                step.Op = EXPR_FMA;
+                step.Args[0] = program_.Steps[p].Args[0];
+                step.Args[1] = program_.Steps[p].Args[1];
+                step.Args[2] = z;
+                dead[p] = true;
+                ++program_.Fused;
+                break;
+            }
+        }
+
+        std::vector<expr_step> live;
+        for (size_t s = 0; s < program_.Steps.size(); ++s)
+            if (!dead[s])
+                live.push_back(program_.Steps[s]);
+        program_.Steps.swap(live);
+    }
+
+    const std::vector<expr_node> &nodes_;
+    expr_program &program_;
+    std::map<std::string, size_t> names_;
+    std::map<double, size_t> numbers_;
+    std::map<std::tuple<expr_op, size_t, size_t>, size_t> steps_;
+};
+
+
+// run program on one row; value holds a pointer per slot, the operand and number
+// slots already set, the step slots pointing at scratch ciphertexts
+static void run_program (const expr_program &program, std::vector<mpz_rational *> &value, const mpz_t N)
+{
+    for (const auto &step : program.Steps)
+    {
+        mpz_rational &r = *value[step.Slot];
+        const mpz_rational &x = *value[step.Args[0]];
+        switch (step.Op)
+        {
+        case EXPR_ADD:
+            add_rational(r, x, *value[step.Args[1]], N);
+            break;
+        case EXPR_SUB:
+            sub_rational(r, x, *value[step.Args[1]], N);
+            break;
+        case EXPR_MUL:
+            mul_rational(r, x, *value[step.Args[1]], N);
+            break;
+        case EXPR_FMA:
+            fma_rational(r, x, *value[step.Args[1]], *value[step.Args[2]], N);
+            break;
+        case EXPR_NEG:
+            // smod keeps the sign, so -a stays in (-N, N)
+            mpz_neg(r.Numerator, x.Numerator);
+            mpz_set(r.Denominator, x.Denominator);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// split NAME=FILE
+static void parse_binding (const std::string &binding, std::string &name, std::string &file)
+{
+    size_t eq = binding.find('=');
+    if (eq == 0 || eq == std::string::npos || eq + 1 == binding.size())
+        throw std::runtime_error("expected NAME=FILE, got \"" + binding + "\"");
+    name = binding.substr(0, eq);
+    file = binding.substr(eq + 1);
+}
+
+// reads several columns in lockstep; throws if their lengths differ
+class column_set_source
+{
+public:
+    column_set_source (const std::vector<std::string> &paths, size_t batchSize)
+    {
+        for (const auto &path : paths)
+            sources_.emplace_back(new column_source(path, batchSize));
+    }
+
+    bool operator() (std::vector<column_batch> &batch)
+    {
+        batch.resize(sources_.size());
+        bool more = false;
+        for (size_t c = 0; c < sources_.size(); ++c)
+        {
+            more = (*sources_[c])(batch[c]) || more;
+            if (batch[c].size() != batch[0].size())
+                throw std::runtime_error("columns differ in length");
+        }
+        return more;
+    }
+
+private:
+    std::vector<std::unique_ptr<column_source>> sources_;
+};
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("expression,e", po::value<std::string>()->required(), "Expression to evaluate (also positional).")
+            ("cipherText,c", po::value<std::vector<std::string>>(), "NAME=FILE: bind NAME to a ciphertext (repeatable).")
+            ("column,C", po::value<std::vector<std::string>>(), "NAME=FILE: bind NAME to a ciphertext column (repeatable).")
+            ("stats", "Print the compiled program size to stderr.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted result (a column if any operand is one).")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads (column mode).");
+
+        po::positional_options_description positional;
+        positional.add("expression", 1);
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).positional(positional).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        std::vector<expr_node> nodes;
+        expr_parser parser(vm["expression"].as<std::string>(), nodes);
+        size_t root = parser.parse();
+
+        expr_program program;
+        expr_compiler compiler(nodes, program);
+        compiler.compile(root);
+
+        // name -> (file, is column)
+        std::map<std::string, std::pair<std::string, bool>> bindings;
+        for (int column = 0; column < 2; ++column)
+        {
+            const char *option = column ? "column" : "cipherText";
+            if (!vm.count(option))
+                continue;
+            for (const auto &binding : vm[option].as<std::vector<std::string>>())
+            {
+                std::string name, file;
+                parse_binding(binding, name, file);
+                if (!bindings.emplace(name, std::make_pair(file, column == 1)).second)
+                    throw std::runtime_error(name + " is bound twice");
+            }
+        }
+
+        // load each ciphertext operand once; column operands are read row by row
+        size_t operands = program.Names.size();
+        if (operands == 0)
+            throw std::runtime_error("the expression has no ciphertext operand");
+        std::vector<mpz_rational> singles(operands);
+        std::vector<size_t> columnOf(operands, operands);
+        std::vector<std::string> columnFiles;
+        for (size_t k = 0; k < operands; ++k)
+        {
+            auto b = bindings.find(program.Names[k]);
+            if (b == bindings.end())
+                throw std::runtime_error(program.Names[k] + " is not bound (use -c or -C " + program.Names[k] + "=FILE)");
+            rational_init(singles[k]);
+            if (b->second.second)
+            {
+                columnOf[k] = columnFiles.size();
+                columnFiles.push_back(b->second.first);
+            }
+            else
+                read_ciphertext(b->second.first, singles[k]);
+        }
+
+        std::vector<mpz_rational> numbers(program.Numbers.size());
+        for (size_t j = 0; j < numbers.size(); ++j)
+        {
+            rational_init(numbers[j]);
+            rational_from_double(numbers[j].Numerator, numbers[j].Denominator, program.Numbers[j]);
+        }
+
+        // value slots of one evaluator: operands and numbers, then its own scratch
+        auto make_slots = [&](std::vector<mpz_rational> &scratch, std::vector<mpz_rational *> &value)
+        {
+            scratch.resize(program.Slots - operands - numbers.size());
+            for (auto &s : scratch)
+                rational_init(s);
+            value.resize(program.Slots);
+            for (size_t k = 0; k < operands; ++k)
+                value[k] = &singles[k];
+            for (size_t j = 0; j < numbers.size(); ++j)
+                value[operands + j] = &numbers[j];
+            for (size_t s = 0; s < scratch.size(); ++s)
+                value[operands + numbers.size() + s] = &scratch[s];
+        };
+
+        size_t rows = 1;
+        if (columnFiles.empty())
+        {
+            std::vector<mpz_rational> scratch;
+            std::vector<mpz_rational *> value;
+            make_slots(scratch, value);
+            run_program(program, value, N);
+            write_ciphertext(vm["output"].as<std::string>(), *value[program.Result]);
+            clear_column(scratch);
+        }
+        else
+        {
+            pipeline_options opt = default_pipeline_options(vm["threads"].as<unsigned>());
+            column_set_source source(columnFiles, opt.BatchSize);
+            column_sink sink(vm["output"].as<std::string>());
+
+            std::vector<std::vector<mpz_rational>> scratch(opt.Threads);
+            std::vector<std::vector<mpz_rational *>> value(opt.Threads);
+            for (unsigned w = 0; w < opt.Threads; ++w)
+                make_slots(scratch[w], value[w]);
+
+            rows = 0;
+            run_pipeline<std::vector<column_batch>>(opt, source, [&](unsigned w, std::vector<column_batch> &batch)
+            {
+                for (size_t i = 0; i < batch[0].size(); ++i)
+                {
+                    for (size_t k = 0; k < operands; ++k)
+                        if (columnOf[k] != operands)
+                            value[w][k] = &batch[columnOf[k]][i];
+                    run_program(program, value[w], N);
+                    rational_set(batch[0][i], *value[w][program.Result]);
+                }
+            },
+            [&](std::vector<column_batch> &batch)
+            {
+                rows += batch[0].size();
+                sink(batch[0]);
+            });
+            sink.close();
+
+            for (auto &s : scratch)
+                clear_column(s);
+        }
+
+        if (vm.count("stats"))
+            std::cerr << operands << " operands (" << columnFiles.size() << " columns), " << numbers.size()
+                      << " numbers, " << program.Steps.size() << " steps per row (" << program.Merged
+                      << " repeated subexpressions merged, " << program.Fused << " fused multiply-adds), "
+                      << rows << " rows" << std::endl;
+
+        // cleanup
+        clear_column(singles);
+        clear_column(numbers);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
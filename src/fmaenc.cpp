@@ -0,0 +1,186 @@
+/*
+ *  ahefutil fmaenc -p public_key.json -a A.enc -b B.enc -c C.enc -o D.enc
+ *  ahefutil fmaenc -p public_key.json -A a.col -B b.col -C c.col -o d.col -t 8
+ *
+ *  Fused multiply-add E(a*b + c) of three ciphertexts, or element-wise of
+ *  three aligned columns, in place of mulenc followed by addenc. The products
+ *  of the numerator and denominator algebra are kept unreduced and each of
+ *  numerator and denominator is reduced once (fma_rational): 2 reductions per
+ *  result instead of 4, and no intermediate ciphertext or column is written.
+ *
+ *  --stats reports the reductions performed against the separate mulenc and
+ *  addenc steps, and the time per result.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// aligned rows of three columns
+struct column_triple_batch
+{
+    column_batch A;
+    column_batch B;
+    column_batch C;
+};
+
+// reads three columns in lockstep; throws if their lengths differ
+class column_triple_source
+{
+public:
+    column_triple_source (const std::string &pathA, const std::string &pathB, const std::string &pathC, size_t batchSize)
+        : a_(pathA, batchSize), b_(pathB, batchSize), c_(pathC, batchSize) {}
+
+    bool operator() (column_triple_batch &batch)
+    {
+        bool more = a_(batch.A);
+        b_(batch.B);
+        c_(batch.C);
+        if (batch.A.size() != batch.B.size() || batch.A.size() != batch.C.size())
+            throw std::runtime_error("columns differ in length");
+        return more;
+    }
+
+private:
+    column_source a_;
+    column_source b_;
+    column_source c_;
+};
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("ENCRYPTED_A,a", po::value<std::string>(), "File containing ENCRYPTED_A.")
+            ("ENCRYPTED_B,b", po::value<std::string>(), "File containing ENCRYPTED_B.")
+            ("ENCRYPTED_C,c", po::value<std::string>(), "File containing ENCRYPTED_C.")
+            ("columnA,A", po::value<std::string>(), "File containing a ciphertext column A.")
+            ("columnB,B", po::value<std::string>(), "File containing a ciphertext column B of the same length.")
+            ("columnC,C", po::value<std::string>(), "File containing a ciphertext column C of the same length.")
+            ("stats", "Print the reductions saved and the time per result to stderr.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted result E(a*b + c).")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads (column mode).");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            size_t single = vm.count("ENCRYPTED_A") + vm.count("ENCRYPTED_B") + vm.count("ENCRYPTED_C");
+            size_t columns = vm.count("columnA") + vm.count("columnB") + vm.count("columnC");
+            if (!((single == 3 && columns == 0) || (single == 0 && columns == 3)))
+                throw po::error("either -a, -b and -c or -A, -B and -C are required");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        size_t count = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        if (vm.count("columnA"))
+        {
+            // element-wise over three aligned columns
+            pipeline_options opt = default_pipeline_options(vm["threads"].as<unsigned>());
+            column_triple_source source(vm["columnA"].as<std::string>(), vm["columnB"].as<std::string>(),
+                                        vm["columnC"].as<std::string>(), opt.BatchSize);
+            column_sink sink(vm["output"].as<std::string>());
+
+            run_pipeline<column_triple_batch>(opt, source, [&](unsigned, column_triple_batch &batch)
+            {
+                for (size_t i = 0; i < batch.A.size(); ++i)
+                    fma_rational(batch.A[i], batch.A[i], batch.B[i], batch.C[i], N);
+            },
+            [&](column_triple_batch &batch)
+            {
+                count += batch.A.size();
+                sink(batch.A);
+            });
+            sink.close();
+        }
+        else
+        {
+            mpz_rational a, b, c;
+            rational_init(a);
+            rational_init(b);
+            rational_init(c);
+            read_ciphertext(vm["ENCRYPTED_A"].as<std::string>(), a);
+            read_ciphertext(vm["ENCRYPTED_B"].as<std::string>(), b);
+            read_ciphertext(vm["ENCRYPTED_C"].as<std::string>(), c);
+
+            fma_rational(a, a, b, c, N);
+            write_ciphertext(vm["output"].as<std::string>(), a);
+            count = 1;
+
+            rational_clear(a);
+            rational_clear(b);
+            rational_clear(c);
+        }
+
+        if (vm.count("stats"))
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << count << " results: " << 2 * count << " reductions (mulenc + addenc: " << 4 * count << "), "
+                      << 1e6 * seconds / std::max<size_t>(1, count) << " us per result" << std::endl;
+        }
+
+        // cleanup
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
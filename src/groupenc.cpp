@@ -0,0 +1,269 @@
+/*
+ *  ahefutil groupenc -p public_key.json -c amounts.txt -o by_region.txt -t 8
+ *
+ *  Encrypted group-by SUM: the input is a keyed column, one record
+ *
+ *      <plaintext key> <numerator HEX> <denominator HEX>
+ *
+ *  per line, the output a keyed column with one encrypted sum per key, sorted
+ *  by key, ready for `decrypt -C`.
+ *
+ *  Every worker folds its batches into a thread-local open-addressing hash
+ *  table (linear probing, dense group storage). At the end the groups are
+ *  partitioned by hash across the threads and each thread merges its
+ *  partition of all local tables, so the merge needs no locks either.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+struct keyed_batch
+{
+    std::vector<std::string> Keys;
+    column_batch Cipher;
+};
+
+// reads batches of records from a keyed column
+class keyed_source
+{
+public:
+    keyed_source (const std::string &path, size_t batchSize) : ifs_(path), batchSize_(batchSize)
+    {
+        if (!ifs_)
+            throw std::runtime_error("cannot open " + path);
+    }
+
+    bool operator() (keyed_batch &batch)
+    {
+        std::string line, key;
+        mpz_rational r;
+        rational_init(r);
+        while (batch.Keys.size() < batchSize_ && std::getline(ifs_, line))
+        {
+            if (!parse_keyed_column_line(line, key, r))
+                continue;
+            batch.Keys.push_back(key);
+            batch.Cipher.push_back(r);
+            rational_init(r);
+        }
+        rational_clear(r);
+        return !batch.Keys.empty();
+    }
+
+private:
+    std::ifstream ifs_;
+    size_t batchSize_;
+};
+
+
+// plaintext key -> encrypted sum, open addressing with linear probing; the
+// groups are stored densely in insertion order, the slots only index them
+class group_table
+{
+public:
+    struct group
+    {
+        std::string Key;
+        uint64_t Hash;
+        mpz_rational Sum;
+    };
+
+    group_table () : slots_(16) {}
+    ~group_table ()
+    {
+        for (auto &g : groups_)
+            rational_clear(g.Sum);
+    }
+    group_table (const group_table &) = delete;
+    group_table &operator= (const group_table &) = delete;
+
+    static uint64_t hash (const std::string &key) { return std::hash<std::string>()(key); }
+
+    // the group of key, created as E(0) when missing
+    group &find_or_insert (const std::string &key, uint64_t h)
+    {
+        // keep the load factor at most 3/4
+        if (4 * (groups_.size() + 1) > 3 * slots_.size())
+            grow();
+
+        size_t mask = slots_.size() - 1;
+        for (size_t i = h & mask; ; i = (i + 1) & mask)
+        {
+            slot &s = slots_[i];
+            if (s.Index == EMPTY)
+            {
+                s.Hash = h;
+                s.Index = groups_.size();
+                group g;
+                g.Key = key;
+                g.Hash = h;
+                rational_init_zero(g.Sum);
+                groups_.push_back(g);
+                return groups_.back();
+            }
+            if (s.Hash == h && groups_[s.Index].Key == key)
+                return groups_[s.Index];
+        }
+    }
+
+    std::vector<group> &groups () { return groups_; }
+
+private:
+    static const size_t EMPTY = ~size_t(0);
+
+    struct slot
+    {
+        uint64_t Hash = 0;
+        size_t Index = EMPTY;
+    };
+
+    void grow ()
+    {
+        std::vector<slot> bigger(2 * slots_.size());
+        size_t mask = bigger.size() - 1;
+        for (size_t g = 0; g < groups_.size(); ++g)
+        {
+            size_t i = groups_[g].Hash & mask;
+            while (bigger[i].Index != EMPTY)
+                i = (i + 1) & mask;
+            bigger[i].Hash = groups_[g].Hash;
+            bigger[i].Index = g;
+        }
+        slots_.swap(bigger);
+    }
+
+    std::vector<slot> slots_;
+    std::vector<group> groups_;
+};
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("column,c", po::value<std::string>()->required(), "File containing a keyed ciphertext column.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File receiving one encrypted sum per key (keyed column).")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads.");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        // fold the records into one table per worker
+        pipeline_options opt = default_pipeline_options(vm["threads"].as<unsigned>());
+        std::vector<group_table> local(opt.Threads);
+
+        keyed_source source(vm["column"].as<std::string>(), opt.BatchSize);
+        run_pipeline<keyed_batch>(opt, source, [&](unsigned w, keyed_batch &batch)
+        {
+            for (size_t i = 0; i < batch.Keys.size(); ++i)
+            {
+                group_table::group &g = local[w].find_or_insert(batch.Keys[i], group_table::hash(batch.Keys[i]));
+                add_rational(g.Sum, g.Sum, batch.Cipher[i], N);
+            }
+        });
+
+        // partition the groups by hash and merge every partition in its own thread
+        size_t parts = opt.Threads;
+        std::vector<group_table> merged(parts);
+        parallel_chunks(parts, parts, [&](size_t, size_t first, size_t last)
+        {
+            for (size_t part = first; part < last; ++part)
+            {
+                for (auto &table : local)
+                {
+                    for (auto &g : table.groups())
+                    {
+                        if ((g.Hash >> 32) % parts != part)
+                            continue;
+                        group_table::group &m = merged[part].find_or_insert(g.Key, g.Hash);
+                        add_rational(m.Sum, m.Sum, g.Sum, N);
+                    }
+                }
+            }
+        });
+
+        // write the groups sorted by key
+        std::vector<const group_table::group *> groups;
+        for (auto &table : merged)
+            for (auto &g : table.groups())
+                groups.push_back(&g);
+        std::sort(groups.begin(), groups.end(), [](const group_table::group *a, const group_table::group *b)
+        {
+            return a->Key < b->Key;
+        });
+
+        std::ofstream ofs (vm["output"].as<std::string>(), std::ofstream::out);
+        if (!ofs)
+            throw std::runtime_error("cannot write " + vm["output"].as<std::string>());
+        for (auto g : groups)
+            ofs << format_keyed_column_line(g->Key, g->Sum) << '\n';
+        ofs.close();
+
+        // cleanup
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,219 @@
+/*
+ *  ahefutil matenc -p public_key.json -a W.mat -b X.mat -o Y.mat -t 8
+ *
+ *  Multiply two encrypted matrices (a vector is a matrix with one column):
+ *
+ *      E(C)_ij = sum_k E(A)_ik * E(B)_kj
+ *
+ *  with the same homomorphic multiplication and addition as mulenc and addenc,
+ *  k in ascending order, in a single process instead of one run per element.
+ *
+ *  - Output rows are partitioned across threads.
+ *  - Each thread walks k and j in tiles of --tile ciphertexts, so that the
+ *    tile of B it reuses for all of its rows stays in cache.
+ *  - When every denominator of A and B is 1, i.e. the plaintexts are integers
+ *    (or packed lanes), each dot product is accumulated in one wide integer
+ *    and reduced mod N once at the end instead of once per term.
+ *
+ *  --stats reports the modular multiplications performed per second.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+static bool unit_denominators (const encrypted_matrix &m)
+{
+    for (const auto &x : m.Elements)
+        if (mpz_cmp_ui(x.Denominator, 1) != 0)
+            return false;
+    return true;
+}
+
+// modular multiplications of C = A*B, counting a delayed reduction as one
+static double modmuls (const encrypted_matrix &A, const encrypted_matrix &B, bool integer)
+{
+    double terms = double(A.Rows) * A.Cols * B.Cols;
+    return integer ? terms : 5 * terms;
+}
+
+// C = A * B
+static void multiply (encrypted_matrix &C, const encrypted_matrix &A, const encrypted_matrix &B,
+                      const mpz_t N, unsigned threads, size_t tile, bool integer)
+{
+    C.Rows = A.Rows;
+    C.Cols = B.Cols;
+    C.Elements.resize(C.Rows * C.Cols);
+    for (auto &c : C.Elements)
+        rational_init_zero(c);
+
+    const size_t K = A.Cols;
+    parallel_chunks(A.Rows, threads, [&](size_t, size_t first, size_t last)
+    {
+        mpz_t tn, td, t1;
+        mpz_init(tn);
+        mpz_init(td);
+        mpz_init(t1);
+
+        for (size_t kk = 0; kk < K; kk += tile)
+        {
+            size_t kEnd = std::min(K, kk + tile);
+            for (size_t jj = 0; jj < C.Cols; jj += tile)
+            {
+                size_t jEnd = std::min(C.Cols, jj + tile);
+                for (size_t i = first; i < last; ++i)
+                {
+                    for (size_t k = kk; k < kEnd; ++k)
+                    {
+                        const mpz_rational &a = A(i, k);
+                        for (size_t j = jj; j < jEnd; ++j)
+                        {
+                            const mpz_rational &b = B(k, j);
+                            mpz_rational &c = C(i, j);
+
+                            // integers: c += a*b, reduced after the last k
+                            if (integer)
+                            {
+                                mpz_addmul(c.Numerator, a.Numerator, b.Numerator);
+                                continue;
+                            }
+
+                            // t = a*b as mul_rational, then c = c + t as add_rational
+                            mpz_mul(tn, a.Numerator, b.Numerator);
+                            smod(tn, N);
+                            mpz_mul(td, a.Denominator, b.Denominator);
+                            smod(td, N);
+
+                            mpz_mul(t1, c.Numerator, td);
+                            mpz_addmul(t1, tn, c.Denominator);
+                            mpz_mul(c.Denominator, c.Denominator, td);
+                            mpz_swap(c.Numerator, t1);
+                            smod(c.Numerator, N);
+                            smod(c.Denominator, N);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (integer)
+            for (size_t i = first; i < last; ++i)
+                for (size_t j = 0; j < C.Cols; ++j)
+                    smod(C(i, j).Numerator, N);
+
+        mpz_clear(tn);
+        mpz_clear(td);
+        mpz_clear(t1);
+    });
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("matrixA,a", po::value<std::string>()->required(), "File containing the encrypted left matrix.")
+            ("matrixB,b", po::value<std::string>()->required(), "File containing the encrypted right matrix or vector.")
+            ("tile", po::value<size_t>()->default_value(16), "Tile edge (in ciphertexts) for the k and j loops.")
+            ("stats", "Print the multiplications performed and modmul/s to stderr.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted product matrix.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads.");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (vm["tile"].as<size_t>() == 0)
+                throw po::error("--tile must be positive");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        encrypted_matrix A, B, C;
+        read_matrix(vm["matrixA"].as<std::string>(), A);
+        read_matrix(vm["matrixB"].as<std::string>(), B);
+        if (A.Cols != B.Rows)
+            throw std::runtime_error("cannot multiply a " + std::to_string(A.Rows) + "x" + std::to_string(A.Cols) +
+                                     " by a " + std::to_string(B.Rows) + "x" + std::to_string(B.Cols) + " matrix");
+
+        bool integer = unit_denominators(A) && unit_denominators(B);
+
+        auto start = std::chrono::steady_clock::now();
+        multiply(C, A, B, N, vm["threads"].as<unsigned>(), vm["tile"].as<size_t>(), integer);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (vm.count("stats"))
+        {
+            double count = modmuls(A, B, integer);
+            std::cerr << A.Rows << "x" << A.Cols << " * " << B.Rows << "x" << B.Cols
+                      << (integer ? " (integer, delayed reduction): " : " (rational): ")
+                      << count << " modmul in " << seconds << " s, " << count / seconds << " modmul/s" << std::endl;
+        }
+
+        write_matrix(vm["output"].as<std::string>(), C);
+
+        // cleanup
+        clear_column(A.Elements);
+        clear_column(B.Elements);
+        clear_column(C.Elements);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
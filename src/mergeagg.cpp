@@ -0,0 +1,156 @@
+/*
+ *  ahefutil mergeagg -p public_key.json -o total.json part0.json part1.json ...
+ *
+ *  Merge aggregate files (statenc, accenc, dirsum) into one: the counts are
+ *  added and the encrypted sums combined with add_rational, as addenc does.
+ *  The partials may come from other hosts (statenc --shard i/n on a copy of
+ *  the column) and are merged in any order.
+ *
+ *  Every input must carry the fingerprint of the given public key, or none
+ *  (older files). Partial aggregates tagged "shard": "i/n" must all agree on n
+ *  and cover every slice 0..n-1 exactly once, so a lost or duplicated shard
+ *  is an error rather than a silently wrong total.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// throw unless the shard tags of parts are absent or cover 0..n-1 exactly once
+static void check_shards (const std::vector<encrypted_aggregate> &parts, const std::vector<std::string> &files)
+{
+    size_t tagged = 0, n = 0;
+    std::vector<std::string> seen;
+    for (size_t k = 0; k < parts.size(); ++k)
+    {
+        if (parts[k].Shard.empty())
+            continue;
+
+        size_t i, count;
+        parse_shard(parts[k].Shard, i, count);
+        if (tagged++ == 0)
+        {
+            n = count;
+            seen.assign(n, "");
+        }
+        if (count != n)
+            throw std::runtime_error(files[k] + " is shard " + parts[k].Shard + " of another split (expected n = " +
+                                     std::to_string(n) + ")");
+        if (!seen[i].empty())
+            throw std::runtime_error("shard " + parts[k].Shard + " appears in both " + seen[i] + " and " + files[k]);
+        seen[i] = files[k];
+    }
+
+    if (tagged && tagged != parts.size())
+        throw std::runtime_error("cannot mix shard partials with other aggregates");
+    for (size_t i = 0; i < seen.size(); ++i)
+        if (seen[i].empty())
+            throw std::runtime_error("shard " + std::to_string(i) + "/" + std::to_string(n) + " is missing");
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("aggregate,a", po::value<std::vector<std::string>>()->required(), "Aggregate file to merge (repeatable, also positional).")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the merged aggregate.");
+
+        po::positional_options_description positional;
+        positional.add("aggregate", -1);
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).positional(positional).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+        std::string key = key_fingerprint(N);
+
+        std::vector<std::string> files = vm["aggregate"].as<std::vector<std::string>>();
+        std::vector<encrypted_aggregate> parts(files.size());
+        bool squares = true;
+        for (size_t k = 0; k < files.size(); ++k)
+        {
+            aggregate_init(parts[k], false);
+            aggregate_from_json(read_json(files[k]), parts[k]);
+            if (!parts[k].Key.empty() && parts[k].Key != key)
+                throw std::runtime_error(files[k] + " was computed under another key");
+            squares = squares && parts[k].HasSumOfSquares;
+        }
+        check_shards(parts, files);
+
+        // E(Σx²) survives only if every part has it
+        encrypted_aggregate total;
+        aggregate_init(total, squares);
+        total.Key = key;
+        for (auto &part : parts)
+        {
+            part.HasSumOfSquares = squares;
+            aggregate_merge(total, part, N);
+        }
+
+        write_json(vm["output"].as<std::string>(), aggregate_to_json(total));
+
+        // cleanup
+        for (auto &part : parts)
+            aggregate_clear(part);
+        aggregate_clear(total);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
@@ -1,8 +1,13 @@
 /*
  *  ahefutil mulenc -p public_key.json -a A.enc -b B.enc -o C.enc
+ *  ahefutil mulenc -p public_key.json -A X.col -B Y.col -o Z.col -t 8
  *
  *  Multiply two encrypted numbers and write result to file
  *
+ *  With -A and -B two aligned ciphertext columns are multiplied row by row
+ *  into a ciphertext column, in batches on -t worker threads through the
+ *  struct-of-arrays kernels of soa.hpp (--hugePages backs the batches with
+ *  huge pages).
  */
 
 #define _OPEN_SYS_ITOA_EXT
@@ -18,6 +23,9 @@
 #include "boost/program_options.hpp" 
 
 #include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+#include "soa.hpp"
 
 namespace 
 { 
@@ -28,21 +36,6 @@ namespace
 } // namespace 
 
 
-static void smod (mpz_t a, mpz_t p)
-{
-    if (mpz_sgn(a) < 0)
-    {
-        mpz_abs(a,a);
-        mpz_mod(a, a, p);
-        mpz_neg(a, a);    
-    }
-    else
-    {
-        mpz_mod(a, a, p);
-    }
-}
-
-
 int main(int argc, char** argv)
 {
     try 
@@ -51,10 +44,14 @@ int main(int argc, char** argv)
         po::options_description description("Usage");
         description.add_options()
             ("help,h", "Display this help message") 
-            ("ENCRYPTED_A,a", po::value<std::string>()->required(), "File containing ENCRYPTED_A.")
-            ("ENCRYPTED_B,b", po::value<std::string>()->required(), "File containing ENCRYPTED_B.")
+            ("ENCRYPTED_A,a", po::value<std::string>(), "File containing ENCRYPTED_A.")
+            ("ENCRYPTED_B,b", po::value<std::string>(), "File containing ENCRYPTED_B.")
+            ("columnA,A", po::value<std::string>(), "File containing a ciphertext column A.")
+            ("columnB,B", po::value<std::string>(), "File containing a ciphertext column B of the same length.")
             ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
-            ("output,o", po::value<std::string>()->required(), "File containing the encrypted result.");
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted result.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads (column mode).")
+            ("hugePages", "Back the column batches with huge pages.");
            
         po::variables_map vm;
         
@@ -69,6 +66,11 @@ int main(int argc, char** argv)
             }
             
             po::notify(vm);    
+
+            bool pair = vm.count("ENCRYPTED_A") && vm.count("ENCRYPTED_B");
+            bool columns = vm.count("columnA") && vm.count("columnB");
+            if (pair == columns || vm.count("ENCRYPTED_A") + vm.count("ENCRYPTED_B") + vm.count("columnA") + vm.count("columnB") != 2)
+                throw po::error("either --ENCRYPTED_A and --ENCRYPTED_B or --columnA and --columnB are required");
         }
         catch(po::error& e) 
         { 
@@ -89,6 +91,17 @@ int main(int argc, char** argv)
         mpz_init(N);
         mpz_set_str ( N, public_key["N"].get<std::string>().c_str(), 16 );
 
+        // element-wise over two aligned columns
+        if (vm.count("columnA"))
+        {
+            elementwise_columns(default_pipeline_options(vm["threads"].as<unsigned>()),
+                                vm["columnA"].as<std::string>(), vm["columnB"].as<std::string>(),
+                                vm["output"].as<std::string>(),
+                                SOA_MUL, N, vm.count("hugePages") > 0);
+            mpz_clear(N);
+            return SUCCESS;
+        }
+
 
         // read ciphertext from ENCRYPTED_A
         nlohmann::json ciphertext_A;
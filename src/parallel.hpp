@@ -0,0 +1,44 @@
+/*
+ *  Minimal fork/join helpers for the batch tools.
+ */
+
+#ifndef AHEF_PARALLEL_HPP
+#define AHEF_PARALLEL_HPP
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+
+inline unsigned default_threads ()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// split [0, n) into at most `threads` contiguous chunks and call f(chunk, first, last)
+// on each chunk in its own thread; returns the number of chunks used
+template <typename F>
+size_t parallel_chunks (size_t n, size_t threads, F f)
+{
+    threads = std::max<size_t>(1, std::min(threads, n));
+    size_t chunk = (n + threads - 1) / threads;
+
+    if (threads == 1)
+    {
+        f(size_t(0), size_t(0), n);
+        return 1;
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i)
+    {
+        size_t first = std::min(n, i * chunk);
+        size_t last = std::min(n, first + chunk);
+        workers.emplace_back(f, i, first, last);
+    }
+    for (auto &w : workers)
+        w.join();
+    return threads;
+}
+
+#endif // AHEF_PARALLEL_HPP
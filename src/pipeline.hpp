@@ -0,0 +1,496 @@
+/*
+ *  Staged reader / worker pool / writer pipeline for the batch tools.
+ *
+ *  A reader thread parses input into batches of ciphertexts, a pool of workers
+ *  runs the modular arithmetic on whole batches and a writer thread encodes the
+ *  results in input order. The stages are connected by bounded queues and the
+ *  number of batches in flight is capped, so a slow stage applies backpressure
+ *  instead of buffering the whole file in memory.
+ */
+
+#ifndef AHEF_PIPELINE_HPP
+#define AHEF_PIPELINE_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ahef_gmp.hpp"
+#include "parallel.hpp"
+
+
+struct pipeline_options
+{
+    unsigned Threads;       // number of worker threads
+    size_t BatchSize;       // ciphertexts per batch
+    size_t QueueDepth;      // capacity of each queue, in batches
+};
+
+inline pipeline_options default_pipeline_options (unsigned threads)
+{
+    pipeline_options opt;
+    opt.Threads = std::max(1u, threads);
+    opt.BatchSize = 256;
+    opt.QueueDepth = 2 * opt.Threads;
+    return opt;
+}
+
+
+template <typename T>
+class bounded_queue
+{
+public:
+    explicit bounded_queue (size_t capacity) : capacity_(std::max<size_t>(1, capacity)), closed_(false) {}
+
+    // blocks while the queue is full; returns false once the queue is closed
+    bool push (T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_)
+            return false;
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // blocks while the queue is empty; returns false once it is closed and drained
+    bool pop (T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty())
+            return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close ()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+};
+
+
+// batches handed back by the writer for the reader to refill, so that their
+// buffers are allocated once per batch in flight instead of once per batch
+template <typename T>
+class batch_pool
+{
+public:
+    // a returned batch if there is one, else an empty new one
+    T take ()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty())
+            return T();
+        T item = std::move(items_.back());
+        items_.pop_back();
+        return item;
+    }
+
+    void give (T &&item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items_.push_back(std::move(item));
+    }
+
+private:
+    std::vector<T> items_;
+    std::mutex mutex_;
+};
+
+// a batch of ciphertexts that owns (and clears) its GMP integers
+class column_batch
+{
+public:
+    column_batch () {}
+    column_batch (column_batch &&other) : items_(std::move(other.items_)) { other.items_.clear(); }
+    column_batch &operator= (column_batch &&other)
+    {
+        if (this != &other)
+        {
+            clear_column(items_);
+            items_ = std::move(other.items_);
+            other.items_.clear();
+        }
+        return *this;
+    }
+    column_batch (const column_batch &) = delete;
+    column_batch &operator= (const column_batch &) = delete;
+    ~column_batch () { clear_column(items_); }
+
+    size_t size () const { return items_.size(); }
+    bool empty () const { return items_.empty(); }
+    mpz_rational &operator[] (size_t i) { return items_[i]; }
+    const mpz_rational &operator[] (size_t i) const { return items_[i]; }
+    mpz_rational *begin () { return items_.data(); }
+    mpz_rational *end () { return items_.data() + items_.size(); }
+
+    // append an initialized ciphertext; the batch takes ownership
+    void push_back (const mpz_rational &r) { items_.push_back(r); }
+
+private:
+    std::vector<mpz_rational> items_;
+};
+
+
+// reads batches of ciphertexts from one or more column files in sequence
+class column_source
+{
+public:
+    explicit column_source (const std::vector<std::string> &paths, size_t batchSize)
+        : paths_(paths), next_(0), batchSize_(batchSize) {}
+    explicit column_source (const std::string &path, size_t batchSize)
+        : paths_(1, path), next_(0), batchSize_(batchSize) {}
+
+    // fill batch with up to batchSize ciphertexts; returns false at the end of input
+    bool operator() (column_batch &batch)
+    {
+        std::string line;
+        mpz_rational r;
+        rational_init(r);
+        while (batch.size() < batchSize_ && next_line(line))
+        {
+            if (!parse_column_line(line, r))
+                continue;
+            batch.push_back(r);
+            rational_init(r);
+        }
+        rational_clear(r);
+        return !batch.empty();
+    }
+
+private:
+    bool next_line (std::string &line)
+    {
+        while (true)
+        {
+            if (ifs_.is_open() && std::getline(ifs_, line))
+                return true;
+            if (next_ == paths_.size())
+                return false;
+            ifs_.close();
+            ifs_.clear();
+            ifs_.open(paths_[next_]);
+            if (!ifs_)
+                throw std::runtime_error("cannot open " + paths_[next_]);
+            ++next_;
+        }
+    }
+
+    std::vector<std::string> paths_;
+    size_t next_;
+    size_t batchSize_;
+    std::ifstream ifs_;
+};
+
+
+// reads batches of ciphertexts from the lines of a column file that start in
+// the byte range [first, last); the slices of disjoint ranges covering the file
+// hold every line exactly once
+class column_slice_source
+{
+public:
+    column_slice_source (const std::string &path, std::streamoff first, std::streamoff last, size_t batchSize)
+        : ifs_(path), pos_(first), last_(last), batchSize_(batchSize)
+    {
+        if (!ifs_)
+            throw std::runtime_error("cannot open " + path);
+
+        // the line containing byte first - 1 belongs to the previous slice
+        if (first > 0)
+        {
+            std::string skipped;
+            ifs_.seekg(first - 1);
+            std::getline(ifs_, skipped);
+            pos_ = first + std::streamoff(skipped.size());
+        }
+    }
+
+    bool operator() (column_batch &batch)
+    {
+        std::string line;
+        mpz_rational r;
+        rational_init(r);
+        while (batch.size() < batchSize_ && pos_ < last_ && std::getline(ifs_, line))
+        {
+            pos_ += line.size() + 1;
+            if (!parse_column_line(line, r))
+                continue;
+            batch.push_back(r);
+            rational_init(r);
+        }
+        rational_clear(r);
+        return !batch.empty();
+    }
+
+    // first byte of slice i of n equal slices of a file of size bytes; slice i
+    // is [slice_begin(size, i, n), slice_begin(size, i + 1, n))
+    static std::streamoff slice_begin (std::streamoff size, size_t i, size_t n)
+    {
+        return size / std::streamoff(n) * i + size % std::streamoff(n) * i / std::streamoff(n);
+    }
+
+private:
+    std::ifstream ifs_;
+    std::streamoff pos_;
+    std::streamoff last_;
+    size_t batchSize_;
+};
+
+
+// writes batches of ciphertexts to a column file
+class column_sink
+{
+public:
+    explicit column_sink (const std::string &path) : ofs_(path, std::ofstream::out)
+    {
+        if (!ofs_)
+            throw std::runtime_error("cannot write " + path);
+    }
+
+    void operator() (const column_batch &batch)
+    {
+        std::string out;
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            out += format_column_line(batch[i]);
+            out += '\n';
+        }
+        ofs_ << out;
+    }
+
+    void close ()
+    {
+        ofs_.close();
+        if (!ofs_)
+            throw std::runtime_error("cannot write column");
+    }
+
+private:
+    std::ofstream ofs_;
+};
+
+
+namespace pipeline_detail
+{
+    template <typename Batch>
+    struct sequenced
+    {
+        size_t Sequence;
+        Batch Data;
+    };
+
+    // shared failure and flow-control state of one pipeline run
+    class control
+    {
+    public:
+        explicit control (size_t maxInFlight) : maxInFlight_(maxInFlight), inFlight_(0), failed_(false) {}
+
+        // reader: wait for a free slot; returns false when the pipeline failed
+        bool acquire ()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            slotFree_.wait(lock, [this] { return failed_ || inFlight_ < maxInFlight_; });
+            if (failed_)
+                return false;
+            ++inFlight_;
+            return true;
+        }
+
+        void release ()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --inFlight_;
+            slotFree_.notify_one();
+        }
+
+        void fail (std::exception_ptr e)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!failed_)
+                error_ = e;
+            failed_ = true;
+            slotFree_.notify_all();
+        }
+
+        void rethrow ()
+        {
+            if (error_)
+                std::rethrow_exception(error_);
+        }
+
+    private:
+        size_t maxInFlight_;
+        size_t inFlight_;
+        bool failed_;
+        std::exception_ptr error_;
+        std::mutex mutex_;
+        std::condition_variable slotFree_;
+    };
+}
+
+
+// run source -> work -> sink; work(worker, batch) runs concurrently on up to
+// opt.Threads batches, sink(batch) sees the batches in source order
+template <typename Batch, typename Source, typename Work, typename Sink>
+void run_pipeline (const pipeline_options &opt, Source &&source, Work &&work, Sink &&sink)
+{
+    typedef pipeline_detail::sequenced<Batch> item;
+
+    pipeline_detail::control ctl(2 * opt.QueueDepth + opt.Threads);
+    bounded_queue<item> input(opt.QueueDepth);
+    bounded_queue<item> output(opt.QueueDepth);
+
+    auto abort = [&](std::exception_ptr e)
+    {
+        ctl.fail(e);
+        input.close();
+        output.close();
+    };
+
+    std::thread reader([&]
+    {
+        try
+        {
+            for (size_t seq = 0; ; ++seq)
+            {
+                item it;
+                it.Sequence = seq;
+                if (!source(it.Data) || !ctl.acquire() || !input.push(std::move(it)))
+                    break;
+            }
+        }
+        catch (...) { abort(std::current_exception()); }
+        input.close();
+    });
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < opt.Threads; ++w)
+    {
+        workers.emplace_back([&, w]
+        {
+            try
+            {
+                item it;
+                while (input.pop(it))
+                {
+                    work(w, it.Data);
+                    if (!output.push(std::move(it)))
+                        break;
+                }
+            }
+            catch (...) { abort(std::current_exception()); }
+        });
+    }
+
+    std::thread writer([&]
+    {
+        try
+        {
+            std::map<size_t, Batch> pending;
+            size_t next = 0;
+            item it;
+            while (output.pop(it))
+            {
+                pending.emplace(it.Sequence, std::move(it.Data));
+                for (auto p = pending.find(next); p != pending.end(); p = pending.find(++next))
+                {
+                    sink(p->second);
+                    pending.erase(p);
+                    ctl.release();
+                }
+            }
+        }
+        catch (...) { abort(std::current_exception()); }
+    });
+
+    reader.join();
+    for (auto &w : workers)
+        w.join();
+    output.close();
+    writer.join();
+
+    ctl.rethrow();
+}
+
+// run source -> work without an output stage (aggregations)
+template <typename Batch, typename Source, typename Work>
+void run_pipeline (const pipeline_options &opt, Source &&source, Work &&work)
+{
+    typedef pipeline_detail::sequenced<Batch> item;
+
+    pipeline_detail::control ctl(opt.QueueDepth + opt.Threads);
+    bounded_queue<item> input(opt.QueueDepth);
+
+    auto abort = [&](std::exception_ptr e)
+    {
+        ctl.fail(e);
+        input.close();
+    };
+
+    std::thread reader([&]
+    {
+        try
+        {
+            for (size_t seq = 0; ; ++seq)
+            {
+                item it;
+                it.Sequence = seq;
+                if (!source(it.Data) || !ctl.acquire() || !input.push(std::move(it)))
+                    break;
+            }
+        }
+        catch (...) { abort(std::current_exception()); }
+        input.close();
+    });
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < opt.Threads; ++w)
+    {
+        workers.emplace_back([&, w]
+        {
+            try
+            {
+                item it;
+                while (input.pop(it))
+                {
+                    work(w, it.Data);
+                    ctl.release();
+                }
+            }
+            catch (...) { abort(std::current_exception()); }
+        });
+    }
+
+    reader.join();
+    for (auto &w : workers)
+        w.join();
+
+    ctl.rethrow();
+}
+
+
+#endif // AHEF_PIPELINE_HPP
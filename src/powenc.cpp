@@ -0,0 +1,158 @@
+/*
+ *  ahefutil powenc -p public_key.json -k 3 -c cipher.json -o result.json
+ *  ahefutil powenc -p public_key.json -k 2 -C column.txt -o result.txt -t 4
+ *
+ *  Raise a ciphertext to a plaintext integer exponent k:
+ *
+ *      E(x^k) = smod( a^k / b^k, N)
+ *
+ *  Numerator and denominator are each raised with one sliding-window mpz_powm,
+ *  i.e. O(log k) modular multiplications instead of k-1 mulenc runs. A negative
+ *  exponent inverts the ciphertext first, k = 0 yields E(1) = 1/1.
+ *
+ *  With -C the exponent is applied to every ciphertext of a column, streamed
+ *  through the reader / worker / writer pipeline (see pipeline.hpp).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// smod(a^e, N) for e >= 0; a negative base keeps its sign for odd e
+static void spowm (mpz_t r, const mpz_t a, const mpz_t e, const mpz_t N)
+{
+    bool negative = mpz_sgn(a) < 0 && mpz_odd_p(e);
+    mpz_abs(r, a);
+    mpz_powm(r, r, e, N);
+    if (negative)
+        mpz_neg(r, r);
+}
+
+// x = x^k in place
+static void pow_rational (mpz_rational &x, long k, const mpz_t N)
+{
+    if (k < 0)
+    {
+        // E(1/x) = b / a, keeping the sign in the numerator
+        mpz_swap(x.Numerator, x.Denominator);
+        if (mpz_sgn(x.Denominator) < 0)
+        {
+            mpz_neg(x.Numerator, x.Numerator);
+            mpz_neg(x.Denominator, x.Denominator);
+        }
+    }
+
+    mpz_t e;
+    mpz_init_set_ui(e, k < 0 ? -static_cast<unsigned long>(k) : static_cast<unsigned long>(k));
+    spowm(x.Numerator, x.Numerator, e, N);
+    spowm(x.Denominator, x.Denominator, e, N);
+    mpz_clear(e);
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("exponent,k", po::value<long>()->required(), "Plaintext integer exponent k.")
+            ("cipherText,c", po::value<std::string>(), "File containing a ciphertext.")
+            ("column,C", po::value<std::string>(), "File containing a ciphertext column.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted result.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads (column mode).");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (vm.count("cipherText") + vm.count("column") != 1)
+                throw po::error("exactly one of --cipherText or --column is required");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        long k = vm["exponent"].as<long>();
+
+        if (vm.count("cipherText"))
+        {
+            mpz_rational x;
+            rational_init(x);
+            read_ciphertext(vm["cipherText"].as<std::string>(), x);
+            pow_rational(x, k, N);
+            write_ciphertext(vm["output"].as<std::string>(), x);
+            rational_clear(x);
+        }
+        else
+        {
+            pipeline_options opt = default_pipeline_options(vm["threads"].as<unsigned>());
+            column_source source(vm["column"].as<std::string>(), opt.BatchSize);
+            column_sink sink(vm["output"].as<std::string>());
+
+            run_pipeline<column_batch>(opt, source, [&](unsigned, column_batch &batch)
+            {
+                for (auto &x : batch)
+                    pow_rational(x, k, N);
+            }, sink);
+            sink.close();
+        }
+
+        // cleanup
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
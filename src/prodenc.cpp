@@ -0,0 +1,154 @@
+/*
+ *  ahefutil prodenc -p public_key.json -o product.json g1.enc g2.enc g3.enc ...
+ *  ahefutil prodenc -p public_key.json -o product.json -C rates.txt -t 8
+ *
+ *  Multiply any number of ciphertexts, E(x_1 * ... * x_n), with a balanced
+ *  product tree instead of a left-deep chain of mulenc runs. Level l of the
+ *  tree multiplies the pairs (i, i + 2^l) for all i divisible by 2^(l+1); the
+ *  pairs of one level are independent and spread over the worker threads, so
+ *  the wall time is O(log n) multiplications deep on enough cores.
+ *
+ *  smod keeps the sign and reduces the magnitude mod N, both of which commute
+ *  with the order of multiplication, so the result is bit-identical to the
+ *  sequential chain (--sequential computes that one instead).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// r = x_0 * x_1 * ... * x_(n-1), left to right
+static void product_chain (mpz_rational &r, const std::vector<mpz_rational> &x, const mpz_t N)
+{
+    rational_set(r, x[0]);
+    for (size_t i = 1; i < x.size(); ++i)
+        mul_rational(r, r, x[i], N);
+}
+
+// r = x_0 * x_1 * ... * x_(n-1) as a balanced tree; overwrites x
+static void product_tree (mpz_rational &r, std::vector<mpz_rational> &x, const mpz_t N, unsigned threads)
+{
+    for (size_t stride = 1; stride < x.size(); stride *= 2)
+    {
+        size_t pairs = (x.size() - stride + 2 * stride - 1) / (2 * stride);
+        parallel_chunks(pairs, threads, [&](size_t, size_t first, size_t last)
+        {
+            for (size_t k = first; k < last; ++k)
+                mul_rational(x[2 * stride * k], x[2 * stride * k], x[2 * stride * k + stride], N);
+        });
+    }
+    rational_set(r, x[0]);
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("cipherText,c", po::value<std::vector<std::string>>(), "File containing a ciphertext factor (repeatable, also positional).")
+            ("column,C", po::value<std::vector<std::string>>(), "File containing a ciphertext column of factors (repeatable).")
+            ("sequential", "Multiply in a left-deep chain instead of a balanced tree.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted product.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads.");
+
+        po::positional_options_description positional;
+        positional.add("cipherText", -1);
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).positional(positional).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (!vm.count("cipherText") && !vm.count("column"))
+                throw po::error("at least one --cipherText or --column is required");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        std::vector<mpz_rational> factors;
+        if (vm.count("cipherText"))
+        {
+            for (const auto &file : vm["cipherText"].as<std::vector<std::string>>())
+            {
+                mpz_rational x;
+                rational_init(x);
+                factors.push_back(x);
+                read_ciphertext(file, factors.back());
+            }
+        }
+        if (vm.count("column"))
+            for (const auto &file : vm["column"].as<std::vector<std::string>>())
+                read_column(file, factors);
+
+        // the empty product is E(1)
+        mpz_rational product;
+        rational_init_one(product);
+        if (vm.count("sequential") && !factors.empty())
+            product_chain(product, factors, N);
+        else if (!factors.empty())
+            product_tree(product, factors, N, vm["threads"].as<unsigned>());
+
+        write_ciphertext(vm["output"].as<std::string>(), product);
+
+        // cleanup
+        rational_clear(product);
+        clear_column(factors);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
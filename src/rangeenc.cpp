@@ -0,0 +1,379 @@
+/*
+ *  ahefutil rangeenc -p public_key.json -i series.idx -a new_readings.col
+ *  ahefutil rangeenc -p public_key.json -i series.idx -r 1000:1999 -r 5:8 -o sums.col
+ *
+ *  Encrypted range sums over an append-only ciphertext series, backed by a
+ *  Fenwick tree of encrypted partial sums stored on disk. Node k holds
+ *
+ *      E(x_(k - lowbit(k) + 1) + ... + x_k)
+ *
+ *  so appending x_n reads O(log n) earlier nodes and writes one new node (old
+ *  nodes never change), and a range sum x_first + ... + x_last needs O(log n)
+ *  additions (add_rational, as addenc) and one subtraction (sub_rational, as
+ *  subenc) instead of a scan of the range. Positions are 1-based and the
+ *  ranges inclusive; the output has one ciphertext per range, for decrypt -C.
+ *
+ *  The index file is itself a ciphertext column: a fixed 64-byte header line
+ *
+ *      #fenwick <count> <width>
+ *
+ *  followed by one fixed-width record per node, both HEX numbers zero-padded
+ *  to <width> digits (the length of N) behind a sign column (' ' or '-'), so
+ *  node k is read with a single seek. Appends write the new records first and
+ *  the count last, each fsync(2)ed, under flock(2) on "<index>.lock"; a crash
+ *  or power loss in between leaves the previous index, whose stale tail is
+ *  overwritten by the next append. Queries open an existing index read-only,
+ *  so they also work on read-only files and never create one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+static bool file_exists (const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+// take an exclusive lock on "<path>.lock", released when the process exits
+static int lock_index (const std::string &path)
+{
+    std::string lockFile = path + ".lock";
+    int fd = open(lockFile.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0)
+        throw std::runtime_error("cannot lock " + lockFile);
+    return fd;
+}
+
+static size_t lowbit (size_t k)
+{
+    return k & (~k + 1);
+}
+
+
+// Fenwick tree of encrypted partial sums in a file of fixed-width records
+class fenwick_index
+{
+public:
+    static const size_t HEADER_SIZE = 64;
+
+    // open path for appends (under the lock), creating an empty index for N if
+    // it does not exist, or read-only for queries, which need an existing index
+    fenwick_index (const std::string &path, const mpz_t N, bool writable)
+        : path_(path), count_(0), width_(mpz_sizeinbase(N, 16)), writable_(writable), fd_(-1)
+    {
+        if (!writable && !file_exists(path))
+            throw std::runtime_error("no index " + path);
+        mpz_init_set(N_, N);
+        if (writable && !file_exists(path))
+        {
+            std::ofstream create(path, std::ofstream::out);
+            create << header(0);
+            if (!create)
+                throw std::runtime_error("cannot write " + path);
+        }
+
+        file_.open(path, writable ? std::fstream::in | std::fstream::out | std::fstream::binary
+                                  : std::fstream::in | std::fstream::binary);
+        if (!file_)
+            throw std::runtime_error("cannot open " + path);
+
+        std::string line;
+        std::getline(file_, line);
+        std::istringstream tokens(line);
+        std::string tag;
+        size_t width;
+        if (!(tokens >> tag >> count_ >> width) || tag != "#fenwick")
+            throw std::runtime_error("missing \"#fenwick <count> <width>\" header in " + path);
+        if (width != width_)
+            throw std::runtime_error(path + " was built for a key of another size");
+
+        // fsync(2) through a descriptor of the same file, which fstream does not expose
+        if (writable)
+        {
+            fd_ = open(path.c_str(), O_RDWR);
+            if (fd_ < 0)
+                throw std::runtime_error("cannot open " + path);
+        }
+    }
+    ~fenwick_index ()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+        mpz_clear(N_);
+    }
+    fenwick_index (const fenwick_index &) = delete;
+    fenwick_index &operator= (const fenwick_index &) = delete;
+
+    size_t size () const { return count_; }
+
+    // r = node k, 1 <= k <= size()
+    void node (size_t k, mpz_rational &r)
+    {
+        std::string record(record_size(), '\0');
+        file_.seekg(offset(k));
+        if (!file_.read(&record[0], record.size()))
+            throw std::runtime_error("truncated index " + path_);
+        if (!parse_column_line(record, r))
+            throw std::runtime_error("corrupt record " + std::to_string(k) + " in " + path_);
+    }
+
+    // x_(size()+1) = x; call commit() to publish the new nodes
+    void append (const mpz_rational &x)
+    {
+        if (!writable_)
+            throw std::runtime_error(path_ + " is open read-only");
+        size_t k = count_ + 1;
+        mpz_rational sum, t;
+        rational_init(sum);
+        rational_init(t);
+        rational_set(sum, x);
+
+        // node k = x_k + the nodes covering (k - lowbit(k), k - 1]
+        for (size_t j = k - 1; j > k - lowbit(k); j -= lowbit(j))
+        {
+            node(j, t);
+            add_rational(sum, t, sum, N_);
+        }
+
+        std::string record = format_record(sum);
+        file_.seekp(offset(k));
+        file_.write(record.data(), record.size());
+        if (!file_)
+            throw std::runtime_error("cannot write " + path_);
+        count_ = k;
+
+        rational_clear(sum);
+        rational_clear(t);
+    }
+
+    // write the new count after all appended records are on disk
+    void commit ()
+    {
+        sync();
+        std::string h = header(count_);
+        file_.seekp(0);
+        file_.write(h.data(), h.size());
+        sync();
+    }
+
+    // r = E(x_first + ... + x_last), 1 <= first <= last <= size()
+    void range (mpz_rational &r, size_t first, size_t last)
+    {
+        mpz_rational hi, lo, t;
+        rational_init_zero(hi);
+        rational_init_zero(lo);
+        rational_init(t);
+
+        // prefix(last) - prefix(first - 1); the shared tail of both node chains cancels
+        size_t i = last, j = first - 1;
+        while (i != j)
+        {
+            if (i > j)
+            {
+                node(i, t);
+                add_rational(hi, hi, t, N_);
+                i -= lowbit(i);
+            }
+            else
+            {
+                node(j, t);
+                add_rational(lo, lo, t, N_);
+                j -= lowbit(j);
+            }
+        }
+        sub_rational(r, hi, lo, N_);
+
+        rational_clear(hi);
+        rational_clear(lo);
+        rational_clear(t);
+    }
+
+private:
+    // flush the stream and wait until the device has the data, so the count
+    // can never reach the disk before the records it covers
+    void sync ()
+    {
+        file_.flush();
+        if (!file_ || fsync(fd_) != 0)
+            throw std::runtime_error("cannot write " + path_);
+    }
+
+    std::string header (size_t count) const
+    {
+        std::string h = "#fenwick " + std::to_string(count) + " " + std::to_string(width_);
+        h.resize(HEADER_SIZE - 1, ' ');
+        return h + '\n';
+    }
+
+    // sign column, width digits, space, sign column, width digits, newline
+    size_t record_size () const { return 2 * (width_ + 2); }
+    std::streamoff offset (size_t k) const { return HEADER_SIZE + std::streamoff(k - 1) * record_size(); }
+
+    std::string format_number (const mpz_t a) const
+    {
+        mpz_t m;
+        mpz_init(m);
+        mpz_abs(m, a);
+        std::string digits = to_hex(m);
+        mpz_clear(m);
+        return (mpz_sgn(a) < 0 ? "-" : " ") + std::string(width_ - digits.size(), '0') + digits;
+    }
+
+    std::string format_record (const mpz_rational &r) const
+    {
+        return format_number(r.Numerator) + " " + format_number(r.Denominator) + "\n";
+    }
+
+    std::string path_;
+    size_t count_;
+    size_t width_;
+    mpz_t N_;
+    bool writable_;
+    std::fstream file_;
+    int fd_;
+};
+
+
+// "first:last", 1-based and inclusive
+static void parse_range (const std::string &s, size_t &first, size_t &last)
+{
+    size_t colon = s.find(':');
+    try
+    {
+        if (colon == std::string::npos)
+            throw std::invalid_argument(s);
+        first = std::stoul(s.substr(0, colon));
+        last = std::stoul(s.substr(colon + 1));
+    }
+    catch (std::logic_error &)
+    {
+        throw std::runtime_error("invalid range \"" + s + "\", expected first:last");
+    }
+    if (first == 0 || first > last)
+        throw std::runtime_error("invalid range \"" + s + "\", expected 1 <= first <= last");
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("index,i", po::value<std::string>()->required(), "Index file (created on first append).")
+            ("append,a", po::value<std::vector<std::string>>(), "File containing a ciphertext column to append (repeatable).")
+            ("range,r", po::value<std::vector<std::string>>(), "Range first:last (1-based, inclusive) to sum (repeatable).")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>(), "File receiving one encrypted sum per range (column).");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (!vm.count("append") && !vm.count("range"))
+                throw po::error("at least one --append or --range is required");
+            if (vm.count("range") && !vm.count("output"))
+                throw po::error("--range requires --output");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        std::string path = vm["index"].as<std::string>();
+        if (vm.count("append"))
+        {
+            int lock = lock_index(path);
+            fenwick_index index(path, N, true);
+            for (const auto &file : vm["append"].as<std::vector<std::string>>())
+            {
+                std::vector<mpz_rational> column;
+                read_column(file, column);
+                for (const auto &x : column)
+                    index.append(x);
+                clear_column(column);
+            }
+            index.commit();
+            close(lock);
+        }
+
+        if (vm.count("range"))
+        {
+            fenwick_index index(path, N, false);
+            std::vector<mpz_rational> sums;
+            for (const auto &s : vm["range"].as<std::vector<std::string>>())
+            {
+                size_t first, last;
+                parse_range(s, first, last);
+                if (last > index.size())
+                    throw std::runtime_error("range " + s + " exceeds the " + std::to_string(index.size()) +
+                                             " indexed ciphertexts");
+                mpz_rational r;
+                rational_init(r);
+                index.range(r, first, last);
+                sums.push_back(r);
+            }
+            write_column(vm["output"].as<std::string>(), sums);
+            clear_column(sums);
+        }
+
+        // cleanup
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,188 @@
+/*
+ *  ahefutil rollenc -p public_key.json -c readings.col -w 24 -o last_24.col
+ *
+ *  Rolling-window sums over an ordered ciphertext column: output line i is
+ *
+ *      E(x_(i-w+1) + ... + x_i)
+ *
+ *  the encrypted sum of the last w inputs (of all inputs so far while fewer
+ *  than w have arrived; --complete skips those). The window sum is updated
+ *  in place, one add_rational for the arriving and one sub_rational for the
+ *  expiring ciphertext, kept in a ring buffer of the last w inputs, so each
+ *  record costs O(1) homomorphic operations whatever the window size.
+ *
+ *  Every ciphertext that ever entered the window leaves its denominator in the
+ *  running sum, so long streams need integer plaintexts (denominator 1). The
+ *  numerator of a difference has no meaningful sign; decrypt -C reads it as a
+ *  balanced residue.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// encrypted sum of the last Window ciphertexts pushed
+class rolling_sum
+{
+public:
+    rolling_sum (size_t window, const mpz_t N) : ring_(window), head_(0), count_(0)
+    {
+        mpz_init_set(N_, N);
+        rational_init_zero(sum_);
+        for (auto &r : ring_)
+            rational_init(r);
+    }
+    ~rolling_sum ()
+    {
+        clear_column(ring_);
+        rational_clear(sum_);
+        mpz_clear(N_);
+    }
+    rolling_sum (const rolling_sum &) = delete;
+    rolling_sum &operator= (const rolling_sum &) = delete;
+
+    // slide the window by x; x receives the new window sum
+    void push (mpz_rational &x)
+    {
+        mpz_rational &slot = ring_[head_];
+        add_rational(sum_, sum_, x, N_);
+        if (count_ >= ring_.size())
+            sub_rational(sum_, sum_, slot, N_);
+
+        mpz_swap(slot.Numerator, x.Numerator);
+        mpz_swap(slot.Denominator, x.Denominator);
+        rational_set(x, sum_);
+
+        head_ = head_ + 1 == ring_.size() ? 0 : head_ + 1;
+        ++count_;
+    }
+
+private:
+    std::vector<mpz_rational> ring_;
+    size_t head_;
+    size_t count_;
+    mpz_rational sum_;
+    mpz_t N_;
+};
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("column,c", po::value<std::string>()->required(), "File containing the ordered ciphertext column.")
+            ("window,w", po::value<size_t>()->required(), "Number of ciphertexts per window.")
+            ("complete", "Only write the sums of complete windows.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File receiving one encrypted window sum per input.");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (vm["window"].as<size_t>() == 0)
+                throw po::error("--window must be positive");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        rolling_sum window(vm["window"].as<size_t>(), N);
+        bool complete = vm.count("complete") > 0;
+
+        // the window is inherently sequential: one worker, with reading and
+        // writing overlapped by the pipeline
+        pipeline_options opt = default_pipeline_options(1);
+        column_source source(vm["column"].as<std::string>(), opt.BatchSize);
+        column_sink sink(vm["output"].as<std::string>());
+        size_t skip = 0;
+
+        run_pipeline<column_batch>(opt, source, [&](unsigned, column_batch &batch)
+        {
+            for (auto &x : batch)
+                window.push(x);
+        },
+        [&](column_batch &batch)
+        {
+            if (!complete)
+            {
+                sink(batch);
+                return;
+            }
+
+            // drop the first w - 1 (partial) sums
+            column_batch tail;
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                if (skip + 1 < vm["window"].as<size_t>())
+                {
+                    ++skip;
+                    continue;
+                }
+                mpz_rational r;
+                rational_init(r);
+                rational_set(r, batch[i]);
+                tail.push_back(r);
+            }
+            sink(tail);
+        });
+        sink.close();
+
+        // cleanup
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
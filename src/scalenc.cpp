@@ -0,0 +1,191 @@
+/*
+ *  ahefutil scalenc -p public_key.json -m mul -k 2.54 -c cipher.json -o result.json
+ *  ahefutil scalenc -p public_key.json -m add -k 273.15 -C column.txt -o result.txt -t 4
+ *
+ *  Combine a ciphertext with a plaintext rational k = k_n/k_d without encrypting k.
+ *  Only the public key is needed and no exponentiation is performed:
+ *
+ *      add:  E(x+k) = smod( (a*k_d + k_n*b) / (b*k_d), N)
+ *      sub:  E(x-k) = smod( (a*k_d - k_n*b) / (b*k_d), N)
+ *      mul:  E(x*k) = smod( (a*k_n) / (b*k_d), N)
+ *      div:  E(x/k) = smod( (a*k_d) / (b*k_n), N)
+ *
+ *  With -C the operation is applied to every ciphertext of a column, streamed
+ *  through the reader / worker / writer pipeline (see pipeline.hpp).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+enum scalar_op { SCALAR_ADD, SCALAR_SUB, SCALAR_MUL, SCALAR_DIV };
+
+static scalar_op parse_scalar_op (const std::string &name)
+{
+    if (name == "add") return SCALAR_ADD;
+    if (name == "sub") return SCALAR_SUB;
+    if (name == "mul") return SCALAR_MUL;
+    if (name == "div") return SCALAR_DIV;
+    throw std::runtime_error("unknown operation " + name + " (expected add, sub, mul or div)");
+}
+
+// x = x op k_n/k_d in place; k_d > 0, t is scratch space
+static void apply_scalar (mpz_rational &x, scalar_op op, const mpz_t k_n, const mpz_t k_d, const mpz_t N, mpz_t t)
+{
+    switch (op)
+    {
+    case SCALAR_ADD:
+    case SCALAR_SUB:
+        mpz_mul(t, k_n, x.Denominator);
+        mpz_mul(x.Numerator, x.Numerator, k_d);
+        if (op == SCALAR_ADD)
+            mpz_add(x.Numerator, x.Numerator, t);
+        else
+            mpz_sub(x.Numerator, x.Numerator, t);
+        mpz_mul(x.Denominator, x.Denominator, k_d);
+        break;
+
+    case SCALAR_MUL:
+        mpz_mul(x.Numerator, x.Numerator, k_n);
+        mpz_mul(x.Denominator, x.Denominator, k_d);
+        break;
+
+    case SCALAR_DIV:
+        // keep the sign of k in the numerator
+        mpz_mul(x.Numerator, x.Numerator, k_d);
+        if (mpz_sgn(k_n) < 0)
+            mpz_neg(x.Numerator, x.Numerator);
+        mpz_abs(t, k_n);
+        mpz_mul(x.Denominator, x.Denominator, t);
+        break;
+    }
+
+    smod(x.Numerator, N);
+    smod(x.Denominator, N);
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("operation,m", po::value<std::string>()->required(), "Operation: add, sub, mul or div.")
+            ("scalar,k", po::value<double>()->required(), "Plaintext rational operand k.")
+            ("cipherText,c", po::value<std::string>(), "File containing a ciphertext.")
+            ("column,C", po::value<std::string>(), "File containing a ciphertext column.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted result.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads (column mode).");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (vm.count("cipherText") + vm.count("column") != 1)
+                throw po::error("exactly one of --cipherText or --column is required");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        scalar_op op = parse_scalar_op(vm["operation"].as<std::string>());
+
+        mpz_t k_n, k_d;
+        mpz_init(k_n);
+        mpz_init(k_d);
+        rational_from_double(k_n, k_d, vm["scalar"].as<double>());
+        if (op == SCALAR_DIV && mpz_sgn(k_n) == 0)
+            throw std::runtime_error("division by zero");
+
+        if (vm.count("cipherText"))
+        {
+            mpz_rational x;
+            rational_init(x);
+            read_ciphertext(vm["cipherText"].as<std::string>(), x);
+
+            mpz_t t;
+            mpz_init(t);
+            apply_scalar(x, op, k_n, k_d, N, t);
+            mpz_clear(t);
+
+            write_ciphertext(vm["output"].as<std::string>(), x);
+            rational_clear(x);
+        }
+        else
+        {
+            pipeline_options opt = default_pipeline_options(vm["threads"].as<unsigned>());
+            column_source source(vm["column"].as<std::string>(), opt.BatchSize);
+            column_sink sink(vm["output"].as<std::string>());
+
+            run_pipeline<column_batch>(opt, source, [&](unsigned, column_batch &batch)
+            {
+                mpz_t t;
+                mpz_init(t);
+                for (auto &x : batch)
+                    apply_scalar(x, op, k_n, k_d, N, t);
+                mpz_clear(t);
+            }, sink);
+            sink.close();
+        }
+
+        // cleanup
+        mpz_clear(k_n);
+        mpz_clear(k_d);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,375 @@
+/*
+ *  Struct-of-arrays batches of ciphertexts for the element-wise column kernels.
+ *
+ *  A column_batch holds one mpz_rational per row, i.e. two separately heap
+ *  allocated limb arrays per ciphertext scattered over the heap. A soa_batch
+ *  stores all numerators of a batch in one array and all denominators in
+ *  another, each row at a fixed stride of whole cache lines (the limbs of N
+ *  rounded up to 64 bytes) and both arrays 64-byte aligned, plus the signed
+ *  limb count of every value. Rows are streamed in order, so the hardware
+ *  prefetcher sees two linear streams per operand, and the kernels request
+ *  every cache line of a row SOA_PREFETCH_ROWS rows ahead of its use.
+ *
+ *  Values are read through read-only mpz views of the limbs (mpz_roinit_n) and
+ *  results computed in preallocated scratch integers, so a kernel does no heap
+ *  allocation per row. Written batches go back to the reader (batch_pool), so
+ *  the arrays are allocated once per batch in flight, not once per batch.
+ *  With hugePages the arrays are backed by explicit huge pages where the
+ *  system has them reserved, else by transparent huge pages.
+ */
+
+#ifndef AHEF_SOA_HPP
+#define AHEF_SOA_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+
+const size_t SOA_ALIGNMENT = 64;                    // bytes, one cache line
+const size_t SOA_HUGE_PAGE = 2 * 1024 * 1024;       // bytes
+const size_t SOA_PREFETCH_ROWS = 4;                 // rows ahead, about the latency of a row
+
+// limbs per row for values in (-N, N): whole cache lines
+inline size_t soa_stride (const mpz_t N)
+{
+    const size_t perLine = SOA_ALIGNMENT / sizeof(mp_limb_t);
+    return (mpz_size(N) + perLine - 1) / perLine * perLine;
+}
+
+// rows per batch that fill at least one huge page per array
+inline size_t soa_huge_rows (size_t stride)
+{
+    return (SOA_HUGE_PAGE + stride * sizeof(mp_limb_t) - 1) / (stride * sizeof(mp_limb_t));
+}
+
+
+class soa_batch
+{
+public:
+    soa_batch () : limbs_(nullptr), bytes_(0), mapped_(false), stride_(0), capacity_(0), rows_(0) {}
+    soa_batch (size_t capacity, size_t stride, bool hugePages) : soa_batch() { reserve(capacity, stride, hugePages); }
+    soa_batch (soa_batch &&other) : soa_batch() { swap(other); }
+    soa_batch &operator= (soa_batch &&other)
+    {
+        if (this != &other)
+        {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+    soa_batch (const soa_batch &) = delete;
+    soa_batch &operator= (const soa_batch &) = delete;
+    ~soa_batch () { release(); }
+
+    // allocate room for capacity rows of stride limbs; drops the current rows
+    void reserve (size_t capacity, size_t stride, bool hugePages)
+    {
+        release();
+        size_t bytes = 2 * capacity * stride * sizeof(mp_limb_t);
+        if (bytes == 0)
+            return;
+
+        void *p = nullptr;
+        if (hugePages)
+        {
+            bytes = (bytes + SOA_HUGE_PAGE - 1) / SOA_HUGE_PAGE * SOA_HUGE_PAGE;
+#ifdef MAP_HUGETLB
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#else
+            p = MAP_FAILED;
+#endif
+            if (p == MAP_FAILED)
+            {
+                // no reserved huge pages: ask for transparent ones
+                p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p == MAP_FAILED)
+                    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+                madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+            }
+            mapped_ = true;
+        }
+        else if (posix_memalign(&p, SOA_ALIGNMENT, bytes) != 0)
+            throw std::bad_alloc();
+
+        limbs_ = static_cast<mp_limb_t *>(p);
+        bytes_ = bytes;
+        stride_ = stride;
+        capacity_ = capacity;
+        sizes_.assign(2 * capacity, 0);
+    }
+
+    size_t size () const { return rows_; }
+    size_t capacity () const { return capacity_; }
+    size_t stride () const { return stride_; }
+    bool empty () const { return rows_ == 0; }
+    bool full () const { return rows_ == capacity_; }
+    void clear () { rows_ = 0; }
+    void resize (size_t rows) { rows_ = rows; }
+
+    // read-only views of row i, valid while the row is unchanged
+    mpz_srcptr numerator (size_t i, mpz_t view) const { return mpz_roinit_n(view, num(i), sizes_[2 * i]); }
+    mpz_srcptr denominator (size_t i, mpz_t view) const { return mpz_roinit_n(view, den(i), sizes_[2 * i + 1]); }
+
+    // store a value of at most stride limbs in row i
+    void set (size_t i, const mpz_t numerator, const mpz_t denominator)
+    {
+        sizes_[2 * i] = store(num(i), numerator);
+        sizes_[2 * i + 1] = store(den(i), denominator);
+    }
+
+    void push_back (const mpz_rational &r)
+    {
+        set(rows_++, r.Numerator, r.Denominator);
+    }
+
+    // hint that row i is read soon: all cache lines of its numerator and denominator
+    void prefetch (size_t i) const
+    {
+        if (i < rows_)
+        {
+            const char *n = reinterpret_cast<const char *>(num(i));
+            const char *d = reinterpret_cast<const char *>(den(i));
+            for (size_t offset = 0; offset < stride_ * sizeof(mp_limb_t); offset += SOA_ALIGNMENT)
+            {
+                __builtin_prefetch(n + offset);
+                __builtin_prefetch(d + offset);
+            }
+        }
+    }
+
+private:
+    mp_limb_t *num (size_t i) const { return limbs_ + i * stride_; }
+    mp_limb_t *den (size_t i) const { return limbs_ + (capacity_ + i) * stride_; }
+
+    int store (mp_limb_t *dst, const mpz_t x)
+    {
+        size_t n = mpz_size(x);
+        if (n > stride_)
+            throw std::runtime_error("ciphertext exceeds the modulus");
+        mpn_copyi(dst, mpz_limbs_read(x), n);
+        return mpz_sgn(x) < 0 ? -int(n) : int(n);
+    }
+
+    void release ()
+    {
+        if (limbs_ && mapped_)
+            munmap(limbs_, bytes_);
+        else
+            free(limbs_);
+        limbs_ = nullptr;
+        bytes_ = 0;
+        mapped_ = false;
+        capacity_ = rows_ = 0;
+        sizes_.clear();
+    }
+
+    void swap (soa_batch &other)
+    {
+        std::swap(limbs_, other.limbs_);
+        std::swap(bytes_, other.bytes_);
+        std::swap(mapped_, other.mapped_);
+        std::swap(stride_, other.stride_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(rows_, other.rows_);
+        sizes_.swap(other.sizes_);
+    }
+
+    mp_limb_t *limbs_;          // capacity rows of numerators, then of denominators
+    size_t bytes_;
+    bool mapped_;
+    size_t stride_;
+    size_t capacity_;
+    size_t rows_;
+    std::vector<int> sizes_;    // signed limb counts: numerator, denominator per row
+};
+
+
+enum soa_op { SOA_ADD, SOA_SUB, SOA_MUL };
+
+// preallocated products for one worker, so the kernel never reallocates
+class soa_scratch
+{
+public:
+    explicit soa_scratch (size_t stride)
+    {
+        mp_bitcnt_t bits = (2 * stride + 1) * GMP_NUMB_BITS;
+        mpz_init2(t1_, bits);
+        mpz_init2(t2_, bits);
+        mpz_init2(t3_, bits);
+    }
+    soa_scratch (const soa_scratch &) = delete;
+    soa_scratch &operator= (const soa_scratch &) = delete;
+    ~soa_scratch ()
+    {
+        mpz_clear(t1_);
+        mpz_clear(t2_);
+        mpz_clear(t3_);
+    }
+
+    // r[i] = x[i] op y[i] for the rows of x; r may be x
+    void apply (soa_op op, soa_batch &r, const soa_batch &x, const soa_batch &y, const mpz_t N)
+    {
+        mpz_t xn, xd, yn, yd;
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            x.prefetch(i + SOA_PREFETCH_ROWS);
+            y.prefetch(i + SOA_PREFETCH_ROWS);
+            x.numerator(i, xn);
+            x.denominator(i, xd);
+            y.numerator(i, yn);
+            y.denominator(i, yd);
+
+            // same algebra as add_rational, sub_rational and mul_rational
+            if (op == SOA_MUL)
+            {
+                mpz_mul(t1_, xn, yn);
+            }
+            else
+            {
+                mpz_mul(t1_, xn, yd);
+                mpz_mul(t2_, yn, xd);
+                if (op == SOA_ADD)
+                    mpz_add(t1_, t1_, t2_);
+                else
+                    mpz_sub(t1_, t1_, t2_);
+            }
+            mpz_mul(t3_, xd, yd);
+            smod(t1_, N);
+            smod(t3_, N);
+            r.set(i, t1_, t3_);
+        }
+        r.resize(x.size());
+    }
+
+private:
+    mpz_t t1_, t2_, t3_;
+};
+
+
+// reads batches of ciphertexts from a column file into soa_batches
+class soa_column_source
+{
+public:
+    soa_column_source (const std::string &path, size_t batchSize, size_t stride, bool hugePages)
+        : ifs_(path), batchSize_(batchSize), stride_(stride), hugePages_(hugePages)
+    {
+        if (!ifs_)
+            throw std::runtime_error("cannot open " + path);
+        rational_init(r_);
+    }
+    ~soa_column_source () { rational_clear(r_); }
+
+    bool operator() (soa_batch &batch)
+    {
+        if (batch.capacity() < batchSize_)
+            batch.reserve(batchSize_, stride_, hugePages_);
+        batch.clear();
+
+        std::string line;
+        while (!batch.full() && std::getline(ifs_, line))
+        {
+            if (parse_column_line(line, r_))
+                batch.push_back(r_);
+        }
+        return !batch.empty();
+    }
+
+private:
+    std::ifstream ifs_;
+    size_t batchSize_;
+    size_t stride_;
+    bool hugePages_;
+    mpz_rational r_;
+};
+
+inline void write_soa_batch (std::ostream &os, const soa_batch &batch)
+{
+    std::string out;
+    mpz_t view;
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        out += to_hex(batch.numerator(i, view));
+        out += ' ';
+        out += to_hex(batch.denominator(i, view));
+        out += '\n';
+    }
+    os << out;
+}
+
+
+// aligned rows of two columns
+struct soa_pair_batch
+{
+    soa_batch A;
+    soa_batch B;
+};
+
+// out[i] = a[i] op b[i] for two aligned columns, through the reader / worker /
+// writer pipeline; the result overwrites the batch of a
+inline void elementwise_columns (const pipeline_options &opt, const std::string &pathA, const std::string &pathB,
+                                 const std::string &outPath, soa_op op, const mpz_t N, bool hugePages)
+{
+    size_t stride = soa_stride(N);
+    size_t batchSize = hugePages ? std::max(opt.BatchSize, soa_huge_rows(stride)) : opt.BatchSize;
+    soa_column_source a(pathA, batchSize, stride, hugePages);
+    soa_column_source b(pathB, batchSize, stride, hugePages);
+
+    std::ofstream ofs(outPath, std::ofstream::out);
+    if (!ofs)
+        throw std::runtime_error("cannot write " + outPath);
+
+    std::vector<std::unique_ptr<soa_scratch>> scratch;
+    for (unsigned w = 0; w < opt.Threads; ++w)
+        scratch.emplace_back(new soa_scratch(stride));
+
+    // the arrays of a batch are reused once it is written
+    batch_pool<soa_pair_batch> pool;
+    try
+    {
+        run_pipeline<soa_pair_batch>(opt, [&](soa_pair_batch &batch)
+        {
+            batch = pool.take();
+            bool more = a(batch.A);
+            b(batch.B);
+            if (batch.A.size() != batch.B.size())
+                throw std::runtime_error("columns differ in length");
+            return more;
+        },
+        [&](unsigned w, soa_pair_batch &batch)
+        {
+            scratch[w]->apply(op, batch.A, batch.A, batch.B, N);
+        },
+        [&](soa_pair_batch &batch)
+        {
+            write_soa_batch(ofs, batch.A);
+            pool.give(std::move(batch));
+        });
+    }
+    catch (...)
+    {
+        // no partial column is left behind
+        ofs.close();
+        unlink(outPath.c_str());
+        throw;
+    }
+
+    ofs.close();
+    if (!ofs)
+        throw std::runtime_error("cannot write " + outPath);
+}
+
+#endif // AHEF_SOA_HPP
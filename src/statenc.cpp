@@ -0,0 +1,240 @@
+/*
+ *  ahefutil statenc -c column.txt -p public_key.json -o stats.json -t 4
+ *
+ *  Stream a ciphertext column once and compute the encrypted sum E(Σx), the
+ *  encrypted sum of squares E(Σx²) and the plaintext count in a single pass.
+ *
+ *  Every ciphertext is loaded once and feeds both accumulators, so no
+ *  intermediate E(x²) is ever serialized. A reader thread parses the column
+ *  into batches which the workers fold into per-thread partial sums; these
+ *  are added together at the end.
+ *
+ *  The output is an aggregate file:
+ *
+ *      { "count": n, "sum": {...}, "sumOfSquares": {...}, "created": ... }
+ *
+ *  whose ciphertexts are decrypted with `decrypt -f sum` and `decrypt -f sumOfSquares`.
+ *
+ *  Sharding splits the column into n byte ranges aligned to lines:
+ *
+ *  - `--shard i/n` aggregates slice i only and writes a partial aggregate
+ *    (tagged "shard": "i/n"), e.g. on one of n hosts holding a copy of the
+ *    column; `mergeagg` adds the partials up.
+ *  - `--shards n` forks n worker processes on this host, one per slice with
+ *    threads/n threads each, and merges their partials into the output.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "json.hpp"
+#include "boost/program_options.hpp"
+
+#include <gmp.h>
+#include "ahef_gmp.hpp"
+#include "pipeline.hpp"
+
+namespace
+{
+  const size_t ERROR_IN_COMMAND_LINE = 1;
+  const size_t SUCCESS = 0;
+  const size_t ERROR_UNHANDLED_EXCEPTION = 2;
+
+} // namespace
+
+
+// a += the aggregate of all ciphertexts of source
+template <typename Source>
+static void aggregate_source (encrypted_aggregate &a, Source &source, unsigned threads, const mpz_t N)
+{
+    // one partial aggregate per worker
+    pipeline_options opt = default_pipeline_options(threads);
+    std::vector<encrypted_aggregate> partial(opt.Threads);
+    for (auto &p : partial)
+        aggregate_init(p, true);
+
+    run_pipeline<column_batch>(opt, source, [&](unsigned w, column_batch &batch)
+    {
+        aggregate_fold(partial[w], batch.begin(), batch.end(), N);
+    });
+
+    // fold the partial aggregates into a
+    for (auto &p : partial)
+    {
+        aggregate_merge(a, p, N);
+        aggregate_clear(p);
+    }
+}
+
+// a += the aggregate of slice i of n of the column at path
+static void aggregate_slice (encrypted_aggregate &a, const std::string &path, size_t i, size_t n,
+                             unsigned threads, const mpz_t N)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        throw std::runtime_error("cannot open " + path);
+
+    pipeline_options opt = default_pipeline_options(threads);
+    column_slice_source source(path, column_slice_source::slice_begin(st.st_size, i, n),
+                               column_slice_source::slice_begin(st.st_size, i + 1, n), opt.BatchSize);
+    aggregate_source(a, source, threads, N);
+}
+
+// run the n slices in n child processes and merge their partial aggregates into a
+static void aggregate_forked (encrypted_aggregate &a, const std::string &path, const std::string &output,
+                              size_t n, unsigned threads, const mpz_t N)
+{
+    unsigned shardThreads = std::max(1u, unsigned(threads / n));
+    std::vector<pid_t> children;
+    for (size_t i = 0; i < n; ++i)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("cannot fork shard " + std::to_string(i));
+        if (pid == 0)
+        {
+            int status = 0;
+            try
+            {
+                encrypted_aggregate part;
+                aggregate_init(part, true);
+                part.Key = a.Key;
+                part.Shard = std::to_string(i) + "/" + std::to_string(n);
+                aggregate_slice(part, path, i, n, shardThreads, N);
+                write_json(output + ".shard" + std::to_string(i), aggregate_to_json(part));
+                aggregate_clear(part);
+            }
+            catch (std::exception &e)
+            {
+                std::cerr << "shard " << i << ": " << e.what() << std::endl;
+                status = 1;
+            }
+            _exit(status);
+        }
+        children.push_back(pid);
+    }
+
+    bool failed = false;
+    for (auto pid : children)
+    {
+        int status;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = true;
+    }
+
+    for (size_t i = 0; i < n && !failed; ++i)
+    {
+        std::string partFile = output + ".shard" + std::to_string(i);
+        encrypted_aggregate part;
+        aggregate_init(part, true);
+        aggregate_from_json(read_json(partFile), part);
+        aggregate_merge(a, part, N);
+        aggregate_clear(part);
+    }
+    for (size_t i = 0; i < n; ++i)
+        unlink((output + ".shard" + std::to_string(i)).c_str());
+
+    if (failed)
+        throw std::runtime_error("a shard failed");
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        namespace po = boost::program_options;
+        po::options_description description("Usage");
+        description.add_options()
+            ("help,h", "Display this help message")
+            ("column,c", po::value<std::string>()->required(), "File containing a ciphertext column.")
+            ("publicKey,p", po::value<std::string>()->required(), "File containing public key.")
+            ("output,o", po::value<std::string>()->required(), "File containing the encrypted aggregate.")
+            ("shard", po::value<std::string>(), "Aggregate only slice i/n of the column into a partial aggregate (for mergeagg).")
+            ("shards", po::value<size_t>(), "Aggregate n slices of the column in n forked processes.")
+            ("threads,t", po::value<unsigned>()->default_value(default_threads()), "Number of worker threads.");
+
+        po::variables_map vm;
+
+        try
+        {
+            po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+
+            if (vm.count("help"))
+            {
+                std::cout << description;
+                return SUCCESS;
+            }
+
+            po::notify(vm);
+
+            if (vm.count("shard") && vm.count("shards"))
+                throw po::error("--shard and --shards are mutually exclusive");
+            if (vm.count("shards") && vm["shards"].as<size_t>() == 0)
+                throw po::error("--shards must be positive");
+        }
+        catch(po::error& e)
+        {
+            std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+            std::cerr << description << std::endl;
+            return ERROR_IN_COMMAND_LINE;
+        }
+
+    // app code goes here
+
+        mpz_t N;
+        mpz_init(N);
+        read_public_key(vm["publicKey"].as<std::string>(), N);
+
+        std::string path = vm["column"].as<std::string>();
+        unsigned threads = vm["threads"].as<unsigned>();
+
+        encrypted_aggregate total;
+        aggregate_init(total, true);
+        total.Key = key_fingerprint(N);
+
+        if (vm.count("shard"))
+        {
+            size_t i, n;
+            parse_shard(vm["shard"].as<std::string>(), i, n);
+            total.Shard = std::to_string(i) + "/" + std::to_string(n);
+            aggregate_slice(total, path, i, n, threads, N);
+        }
+        else if (vm.count("shards"))
+        {
+            aggregate_forked(total, path, vm["output"].as<std::string>(), vm["shards"].as<size_t>(), threads, N);
+        }
+        else
+        {
+            column_source source(path, default_pipeline_options(threads).BatchSize);
+            aggregate_source(total, source, threads, N);
+        }
+
+        // write aggregate to file
+        write_json(vm["output"].as<std::string>(), aggregate_to_json(total));
+
+        // cleanup
+        aggregate_clear(total);
+        mpz_clear(N);
+
+    // app code ends here
+
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Unhandled Exception reached the top of main: "
+                  << e.what()
+                  << ", application will now exit"
+                  << std::endl;
+
+        return ERROR_UNHANDLED_EXCEPTION;
+    }
+
+    return SUCCESS;
+}
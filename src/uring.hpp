@@ -0,0 +1,311 @@
+/*
+ *  Minimal io_uring batch file reader on raw system calls (no liburing).
+ *
+ *  read_files() loads many small files with three submissions per batch:
+ *  all openat(2), then all read(2), then all close(2). This replaces three
+ *  system calls per file by three io_uring_enter(2) calls per batch.
+ *
+ *  Define AHEF_NO_IO_URING, or run on a kernel/sandbox without io_uring,
+ *  to get uring_reader::available() == false; callers then fall back to
+ *  plain reads on a thread pool. A failed io_uring_enter(2) takes back the
+ *  requests the kernel has not consumed, waits for the completion of all
+ *  others (which may still write into the buffers) and retires the ring, so
+ *  the files of that call are reported failed and later calls fall back.
+ */
+
+#ifndef AHEF_URING_HPP
+#define AHEF_URING_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) && !defined(AHEF_NO_IO_URING)
+#define AHEF_HAVE_IO_URING 1
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+
+class uring_reader
+{
+public:
+    // a ring with room for `entries` requests in flight
+    explicit uring_reader (unsigned entries)
+        : fd_(-1), entries_(entries)
+    {
+#ifdef AHEF_HAVE_IO_URING
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd_ = syscall(__NR_io_uring_setup, entries, &p);
+        if (fd_ < 0)
+            return;
+        entries_ = p.sq_entries;
+
+        sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+
+        sqRing_ = mmap(0, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        cqRing_ = mmap(0, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        sqes_ = static_cast<struct io_uring_sqe *>(mmap(0, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+        if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED)
+        {
+            unmap();
+            close(fd_);
+            fd_ = -1;
+            return;
+        }
+
+        char *sq = static_cast<char *>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+
+        char *cq = static_cast<char *>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+#endif
+    }
+
+    ~uring_reader ()
+    {
+#ifdef AHEF_HAVE_IO_URING
+        if (fd_ >= 0)
+        {
+            unmap();
+            close(fd_);
+        }
+#endif
+    }
+
+    uring_reader (const uring_reader &) = delete;
+    uring_reader &operator= (const uring_reader &) = delete;
+
+    bool available () const { return fd_ >= 0; }
+
+    // maximum number of files per read_files() call
+    unsigned capacity () const { return entries_; }
+
+    // read up to `limit` bytes of each file into contents[i]; a file that could
+    // not be read, or is longer than limit, is left empty and flagged in failed[i]
+    void read_files (const std::vector<std::string> &paths, size_t limit,
+                     std::vector<std::string> &contents, std::vector<bool> &failed)
+    {
+        contents.assign(paths.size(), std::string());
+        failed.assign(paths.size(), true);
+#ifdef AHEF_HAVE_IO_URING
+        if (fd_ < 0)
+            return;
+
+        std::vector<int> fds(paths.size(), -1);
+        std::vector<int> result(paths.size(), -1);
+
+        for (size_t first = 0; first < paths.size(); first += entries_)
+        {
+            size_t last = std::min(paths.size(), first + entries_);
+
+            // 1. open all files of the batch
+            for (size_t i = first; i < last; ++i)
+            {
+                struct io_uring_sqe *sqe = prepare(i);
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<unsigned long>(paths[i].c_str());
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            }
+            bool opened = submit_and_wait(last - first, result);
+            for (size_t i = first; i < last; ++i)
+                fds[i] = result[i];
+            if (!opened)
+            {
+                close_batch(fds, first, last);
+                return;
+            }
+
+            // 2. read all opened files; one spare byte detects files longer than limit
+            unsigned n = 0;
+            for (size_t i = first; i < last; ++i)
+            {
+                if (fds[i] < 0)
+                    continue;
+                contents[i].resize(limit + 1);
+                struct io_uring_sqe *sqe = prepare(i);
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = fds[i];
+                sqe->addr = reinterpret_cast<unsigned long>(&contents[i][0]);
+                sqe->len = limit + 1;
+                sqe->off = 0;
+                ++n;
+            }
+            if (!submit_and_wait(n, result))
+            {
+                close_batch(fds, first, last);
+                return;
+            }
+            for (size_t i = first; i < last; ++i)
+            {
+                if (fds[i] < 0)
+                    continue;
+                if (result[i] >= 0 && static_cast<size_t>(result[i]) <= limit)
+                {
+                    contents[i].resize(result[i]);
+                    failed[i] = false;
+                }
+                else
+                {
+                    contents[i].clear();
+                }
+            }
+
+            // 3. close them again; a close never completes with a positive result
+            n = 0;
+            for (size_t i = first; i < last; ++i)
+            {
+                if (fds[i] < 0)
+                    continue;
+                struct io_uring_sqe *sqe = prepare(i);
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = fds[i];
+                result[i] = 1;
+                ++n;
+            }
+            if (!submit_and_wait(n, result))
+            {
+                for (size_t i = first; i < last; ++i)
+                    if (result[i] <= 0)
+                        fds[i] = -1;
+                close_batch(fds, first, last);
+                return;
+            }
+        }
+#else
+        (void) limit;
+#endif
+    }
+
+private:
+#ifdef AHEF_HAVE_IO_URING
+    // after a failed submission, close the files of [first, last) still open
+    static void close_batch (const std::vector<int> &fds, size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; ++i)
+            if (fds[i] >= 0)
+                close(fds[i]);
+    }
+
+    struct io_uring_sqe *prepare (size_t userData)
+    {
+        unsigned tail = *sqTail_ + pending_;
+        unsigned index = tail & sqMask_;
+        struct io_uring_sqe *sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = userData;
+        sqArray_[index] = index;
+        ++pending_;
+        return sqe;
+    }
+
+    // publish the prepared entries and collect exactly n completions into result[user_data];
+    // on failure every consumed request has completed and the ring is retired
+    bool submit_and_wait (unsigned n, std::vector<int> &result)
+    {
+        if (n == 0)
+            return true;
+
+        __atomic_store_n(sqTail_, *sqTail_ + pending_, __ATOMIC_RELEASE);
+        unsigned toSubmit = pending_;
+        pending_ = 0;
+
+        unsigned done = 0;
+        while (done < n)
+        {
+            int ret = syscall(__NR_io_uring_enter, fd_, toSubmit, n - done, IORING_ENTER_GETEVENTS, NULL, 0);
+            if (ret < 0 && errno != EINTR)
+            {
+                // take back what the kernel has not consumed; those never complete
+                unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+                n -= *sqTail_ - head;
+                __atomic_store_n(sqTail_, head, __ATOMIC_RELEASE);
+                drain(done, n, result);
+                retire();
+                return false;
+            }
+            if (ret > 0)
+                toSubmit -= std::min<unsigned>(toSubmit, ret);
+            done += reap(result);
+        }
+        return true;
+    }
+
+    // copy the posted completions into result[user_data]; returns their number
+    unsigned reap (std::vector<int> &result)
+    {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        unsigned count = tail - head;
+        for (; head != tail; ++head)
+        {
+            const struct io_uring_cqe &cqe = cqes_[head & cqMask_];
+            result[cqe.user_data] = cqe.res;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+    // wait until done reaches n, polling if even waiting fails
+    void drain (unsigned done, unsigned n, std::vector<int> &result)
+    {
+        while (done < n)
+        {
+            if (syscall(__NR_io_uring_enter, fd_, 0, n - done, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+            {
+                struct timespec pause = { 0, 1000000 };
+                nanosleep(&pause, NULL);
+            }
+            done += reap(result);
+        }
+    }
+
+    // give up on io_uring: available() turns false and callers fall back
+    void retire ()
+    {
+        unmap();
+        close(fd_);
+        fd_ = -1;
+    }
+
+    void unmap ()
+    {
+        if (sqRing_ != MAP_FAILED)
+            munmap(sqRing_, sqRingSize_);
+        if (cqRing_ != MAP_FAILED)
+            munmap(cqRing_, cqRingSize_);
+        if (sqes_ != MAP_FAILED)
+            munmap(sqes_, sqesSize_);
+    }
+
+    size_t sqRingSize_, cqRingSize_, sqesSize_;
+    void *sqRing_ = MAP_FAILED;
+    void *cqRing_ = MAP_FAILED;
+    struct io_uring_sqe *sqes_ = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+    unsigned *sqHead_, *sqTail_, *sqArray_, *cqHead_, *cqTail_;
+    unsigned sqMask_, cqMask_;
+    struct io_uring_cqe *cqes_;
+    unsigned pending_ = 0;
+#endif
+
+    int fd_;
+    unsigned entries_;
+};
+
+#endif // AHEF_URING_HPP
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# batch encryption throughput per exponentiation kernel for 1024 and 2048 bit N
+
+echo "'N bits','kernel','values','seconds'" >> encrypt.bench
+
+for i in `seq 1 10000`;
+    do
+        NUM=`echo $(( $(( $RANDOM - $RANDOM )) % 10000000 ))`
+        DENOM=`echo $(( $[$RANDOM % 1000] + 1))`
+        echo "${NUM}/${DENOM}" | bc -l >> values.txt
+    done
+
+for K in 512 1024;
+    do
+        eval "../bin/genpkey -o private_keys.json -k ${K}"
+        eval "../bin/encrypt -p private_keys.json --stats"
+        for KERNEL in scalar avx2 avx512ifma;
+            do
+                START=`date +%s.%N`
+                eval "../bin/encrypt -p private_keys.json -i values.txt -o X.col -k ${KERNEL} -t 1" || continue
+                END=`date +%s.%N`
+                ELAPSED=`echo "${END} - ${START}" | bc -l`
+                echo "'$(( 2 * K ))','${KERNEL}','10000','${ELAPSED}'" >> encrypt.bench
+            done
+        eval "../bin/encrypt -p private_keys.json -i values.txt -o X.col --validate"
+    done
+
+eval "rm X.col"
+eval "rm values.txt"
+eval "rm private_keys.json"
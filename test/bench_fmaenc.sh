@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# a*b + c over columns: fused fmaenc against mulenc followed by addenc
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'kind','values','tool','seconds','stats'" >> fmaenc.bench
+
+for KIND in int frac;
+    do
+        for COL in A B C;
+            do
+                for i in `seq 1 10000`;
+                    do
+                        if [ ${KIND} = int ]; then
+                            echo $(( $RANDOM % 2000 - 1000 )) >> ${COL}.txt
+                        else
+                            echo "$(( $RANDOM % 2000 - 1000 ))/4" | bc -l >> ${COL}.txt
+                        fi
+                    done
+                eval "../bin/encrypt -p private_keys.json -i ${COL}.txt -o ${COL}.col"
+            done
+
+        START=`date +%s.%N`
+        STATS=`../bin/fmaenc -p public_key.json -A A.col -B B.col -C C.col -o D.col -t 1 --stats 2>&1`
+        END=`date +%s.%N`
+        ELAPSED=`echo "${END} - ${START}" | bc -l`
+        echo "'${KIND}','10000','fmaenc','${ELAPSED}','${STATS}'" >> fmaenc.bench
+
+        START=`date +%s.%N`
+        eval "../bin/mulenc -p public_key.json -A A.col -B B.col -o AB.col -t 1"
+        eval "../bin/addenc -p public_key.json -A AB.col -B C.col -o D.col -t 1"
+        END=`date +%s.%N`
+        ELAPSED=`echo "${END} - ${START}" | bc -l`
+        echo "'${KIND}','10000','mulenc+addenc','${ELAPSED}',''" >> fmaenc.bench
+
+        eval "rm A.txt B.txt C.txt A.col B.col C.col AB.col D.col"
+    done
+
+eval "rm private_keys.json"
+eval "rm public_key.json"
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# encrypted matrix multiply throughput (modmul/s) per size, kind of plaintext and thread count
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'n','kind','threads','tile','stats'" >> matenc.bench
+
+for n in 32 64 128;
+    do
+        for KIND in int frac;
+            do
+                for i in `seq 1 $(( n * n ))`;
+                    do
+                        if [ ${KIND} = int ]; then
+                            echo $(( $RANDOM % 1000 + 1 )) >> values.txt
+                        else
+                            echo "$(( $RANDOM % 1000 + 1 ))/4" | bc -l >> values.txt
+                        fi
+                    done
+                eval "../bin/encrypt -p private_keys.json -i values.txt -o X.col"
+                echo "#matrix ${n} ${n}" > X.mat
+                cat X.col >> X.mat
+
+                for THREADS in 1 `nproc`;
+                    do
+                        for TILE in 8 32;
+                            do
+                                STATS=`../bin/matenc -p public_key.json -a X.mat -b X.mat -o Y.mat -t ${THREADS} --tile ${TILE} --stats 2>&1`
+                                echo "'${n}','${KIND}','${THREADS}','${TILE}','${STATS}'" >> matenc.bench
+                            done
+                    done
+                eval "rm values.txt"
+            done
+    done
+
+eval "rm X.col"
+eval "rm X.mat"
+eval "rm Y.mat"
+eval "rm private_keys.json"
+eval "rm public_key.json"
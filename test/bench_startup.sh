@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# startup latency: the separate binaries against the ahefutil multi-call binary,
+# by subcommand and via the bin/multicall symlinks (make ahefutil-links;
+# make ahefutil STATIC=1 for the statically linked variant)
+
+RUNS=200
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+eval "../bin/encrypt -p private_keys.json -v 2.5 -o A.enc"
+eval "../bin/encrypt -p private_keys.json -v -3 -o B.enc"
+
+echo "'tool','args','runs','separate','ahefutil','symlink'" >> startup.bench
+
+time_runs () {
+    START=`date +%s.%N`
+    for i in `seq 1 ${RUNS}`;
+        do
+            "$@" > /dev/null
+        done
+    END=`date +%s.%N`
+    echo "(${END} - ${START}) / ${RUNS}" | bc -l
+}
+
+for TOOL in genpkey extract encrypt decrypt addenc subenc mulenc;
+    do
+        SEPARATE=`time_runs ../bin/${TOOL} --help`
+        MULTICALL=`time_runs ../bin/ahefutil ${TOOL} --help`
+        SYMLINK=`time_runs ../bin/multicall/${TOOL} --help`
+        echo "'${TOOL}','--help','${RUNS}','${SEPARATE}','${MULTICALL}','${SYMLINK}'" >> startup.bench
+    done
+
+# a real, microsecond-sized operation: startup dominates
+SEPARATE=`time_runs ../bin/addenc -p public_key.json -a A.enc -b B.enc -o C.enc`
+MULTICALL=`time_runs ../bin/ahefutil addenc -p public_key.json -a A.enc -b B.enc -o C.enc`
+SYMLINK=`time_runs ../bin/multicall/addenc -p public_key.json -a A.enc -b B.enc -o C.enc`
+echo "'addenc','-a A.enc -b B.enc','${RUNS}','${SEPARATE}','${MULTICALL}','${SYMLINK}'" >> startup.bench
+
+SEPARATE=`time_runs ../bin/decrypt -p private_keys.json -c C.enc`
+MULTICALL=`time_runs ../bin/ahefutil decrypt -p private_keys.json -c C.enc`
+SYMLINK=`time_runs ../bin/multicall/decrypt -p private_keys.json -c C.enc`
+echo "'decrypt','-c C.enc','${RUNS}','${SEPARATE}','${MULTICALL}','${SYMLINK}'" >> startup.bench
+
+eval "rm A.enc B.enc C.enc"
+eval "rm private_keys.json"
+eval "rm public_key.json"
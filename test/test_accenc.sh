@@ -0,0 +1,56 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+eval "../bin/genpkey -o other_private_keys.json -k 1024"
+eval "../bin/extract -i other_private_keys.json -o other_public_key.json"
+
+echo "'updaters','sum','count','d(e(sum))','accumulated count','error'" >> accenc.test
+
+# concurrent updaters, each folding one column and one single ciphertext into the same accumulator;
+# the columns hold integers, so only the few fractional singles grow the denominator of the sum
+UPDATERS=8
+SUM=0
+for u in `seq 1 ${UPDATERS}`;
+    do
+        for i in `seq 1 50`;
+            do
+                X=`echo $(( $(( $RANDOM - $RANDOM )) % 100000 ))`
+                echo ${X} >> part_${u}.txt
+                SUM=`echo "${SUM} + ${X}" | bc -l`
+            done
+        eval "../bin/encrypt -p private_keys.json -i part_${u}.txt -o part_${u}.col"
+
+        X=`echo "$(( $RANDOM - $RANDOM ))/8" | bc -l`
+        eval "../bin/encrypt -p private_keys.json -o single_${u}.enc -v ${X}"
+        SUM=`echo "${SUM} + ${X}" | bc -l`
+    done
+
+for u in `seq 1 ${UPDATERS}`;
+    do
+        eval "../bin/accenc -p public_key.json -a total.json -C part_${u}.col -t 2" &
+        eval "../bin/accenc -p public_key.json -a total.json single_${u}.enc" &
+    done
+wait
+
+COUNT=$(( UPDATERS * 51 ))
+OUT=`eval "../bin/decrypt -p private_keys.json -c total.json -f sum"`
+OUT_COUNT=`sed -n 's/.*"count": \([0-9]*\).*/\1/p' total.json`
+ERR=`echo "((${SUM})-(${OUT}))" | bc -l`
+echo "'${UPDATERS}','${SUM}','${COUNT}','${OUT}','${OUT_COUNT}','${ERR}'" >> accenc.test
+
+# a ciphertext under another key fails the update and leaves the accumulator as it was
+echo "'case','result','d(e(sum))','accumulated count'" >> accenc_key.test
+eval "../bin/encrypt -p other_private_keys.json -o other.enc -v 1.5"
+if eval "../bin/accenc -p other_public_key.json -a total.json other.enc" 2> /dev/null;
+    then RESULT="accepted"
+    else RESULT="rejected"
+fi
+OUT=`eval "../bin/decrypt -p private_keys.json -c total.json -f sum"`
+OUT_COUNT=`sed -n 's/.*"count": \([0-9]*\).*/\1/p' total.json`
+echo "'other key','${RESULT}','${OUT}','${OUT_COUNT}'" >> accenc_key.test
+
+eval "rm part_*.txt part_*.col single_*.enc other.enc"
+eval "rm total.json total.json.lock"
+eval "rm private_keys.json other_private_keys.json"
+eval "rm public_key.json other_public_key.json"
@@ -18,7 +18,7 @@ for i in `seq 1 500`;
         eval "../bin/encrypt -p private_keys.json -o B.enc -v ${B}"
         
         C=`echo "${A} + ${B}" | bc -l`
-        eval "../bin/addenc_gmp -p public_key.json -a A.enc -b B.enc -o C.enc"
+        eval "../bin/addenc -p public_key.json -a A.enc -b B.enc -o C.enc"
         
         D_A=`eval "../bin/decrypt -p private_keys.json -c A.enc"`
         D_B=`eval "../bin/decrypt -p private_keys.json -c B.enc"`
@@ -27,8 +27,42 @@ for i in `seq 1 500`;
         echo "'${i}','${A}','${B}','${C}','${D_A}','${D_B}','${OUT}','${ERR}'" >> addenc.test
     done 
 
+# column mode on fractional values
+echo "'row','A','B','A+B','d(e(A+B))','error'" >> addenc_columns.test
+
+for i in `seq 1 300`;
+    do
+        echo "$(( $RANDOM - $RANDOM )).$(( $RANDOM % 1000 ))" >> a.txt
+        echo "$(( $RANDOM % 2000 - 1000 )).$(( $RANDOM % 100 ))" >> b.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i a.txt -o a.col"
+eval "../bin/encrypt -p private_keys.json -i b.txt -o b.col"
+eval "../bin/addenc -p public_key.json -A a.col -B b.col -o c.col -t 4"
+eval "../bin/decrypt -p private_keys.json -C c.col" > c.txt
+
+ROW=0
+paste -d' ' a.txt b.txt c.txt | while read A B OUT;
+    do
+        ROW=$(( ROW + 1 ))
+        C=`echo "(${A}) + (${B})" | bc -l`
+        ERR=`echo "((${C})-(${OUT}))" | bc -l`
+        echo "'${ROW}','${A}','${B}','${C}','${OUT}','${ERR}'" >> addenc_columns.test
+    done
+
+# columns of different length fail the run without output
+echo "'rows A','rows B','result'" >> addenc_length.test
+head -n 200 b.col > short.col
+if eval "../bin/addenc -p public_key.json -A a.col -B short.col -o d.col -t 4" 2> /dev/null;
+    then RESULT="accepted"
+    else RESULT="rejected"
+fi
+if [ -e d.col ]; then RESULT="${RESULT}, output written"; fi
+echo "'300','200','${RESULT}'" >> addenc_length.test
+
 eval "rm A.enc"
 eval "rm B.enc"
 eval "rm C.enc"
+eval "rm a.txt b.txt a.col b.col c.col c.txt short.col"
 eval "rm private_keys.json"
 eval "rm public_key.json"
\ No newline at end of file
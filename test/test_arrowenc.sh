@@ -0,0 +1,41 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'row','plain','d(e(arrow))','error'" >> arrowenc.test
+
+for i in `seq 1 1000`;
+    do
+        echo $(( $RANDOM % 20000 - 10000 )) >> values.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i values.txt -o values.col"
+
+# several record batches, exported and imported back unchanged
+eval "../bin/arrowenc -p public_key.json -C values.col -o values.arrow --rows 300"
+eval "../bin/arrowenc -p public_key.json -i values.arrow -o imported.col"
+if ! cmp -s values.col imported.col; then
+    echo "'roundtrip','','','differs'" >> arrowenc.test
+fi
+eval "../bin/decrypt -p private_keys.json -C imported.col" > imported.txt
+
+ROW=0
+paste -d' ' values.txt imported.txt | while read IN OUT;
+    do
+        ROW=$(( ROW + 1 ))
+        ERR=`echo "((${IN})-(${OUT}))" | bc -l`
+        echo "'${ROW}','${IN}','${OUT}','${ERR}'" >> arrowenc.test
+    done
+
+# keyed column
+awk '{ print "row" NR, $0 }' values.col > keyed.col
+eval "../bin/arrowenc -p public_key.json -C keyed.col --keyed -o keyed.arrow"
+eval "../bin/arrowenc -i keyed.arrow -o keyed_imported.col"
+if ! cmp -s keyed.col keyed_imported.col; then
+    echo "'keyed','','','differs'" >> arrowenc.test
+fi
+
+eval "rm values.txt values.col values.arrow imported.col imported.txt keyed.col keyed.arrow keyed_imported.col"
+eval "rm private_keys.json"
+eval "rm public_key.json"
@@ -0,0 +1,50 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'node','expected','d(e(node))','error'" >> dagenc.test
+
+A=$(( $RANDOM % 1000 ))
+B=$(( $RANDOM % 1000 ))
+C=$(( $RANDOM % 1000 ))
+eval "../bin/encrypt -p private_keys.json -o A.enc -v ${A}"
+eval "../bin/encrypt -p private_keys.json -o B.enc -v ${B}"
+eval "../bin/encrypt -p private_keys.json -o C.enc -v ${C}"
+
+# y = a*b - c, z = b*a + c + a, w = (a - b) * c; a*b and b*a are computed once
+cat > job.json <<EOF
+{ "nodes": [
+    { "id": "w",  "op": "mul", "args": ["amb", "c"], "output": "W.enc" },
+    { "id": "a",  "op": "input", "file": "A.enc" },
+    { "id": "b",  "op": "input", "file": "B.enc" },
+    { "id": "c",  "op": "input", "file": "C.enc" },
+    { "id": "ab", "op": "mul", "args": ["a", "b"] },
+    { "id": "ba", "op": "mul", "args": ["b", "a"] },
+    { "id": "amb", "op": "sub", "args": ["a", "b"] },
+    { "id": "y",  "op": "sub", "args": ["ab", "c"], "output": "Y.enc" },
+    { "id": "z",  "op": "add", "args": ["ba", "c", "a"], "output": "Z.enc" } ] }
+EOF
+
+# the second run loads every output from the cache
+for RUN in computed cached;
+    do
+        eval "../bin/dagenc -p public_key.json -g job.json -t 4 --cache results"
+
+        for NODE in Y Z W;
+            do
+                case ${NODE} in
+                    Y) EXP=$(( A * B - C ));;
+                    Z) EXP=$(( A * B + C + A ));;
+                    W) EXP=$(( (A - B) * C ));;
+                esac
+                OUT=`../bin/decrypt -p private_keys.json -c ${NODE}.enc`
+                ERR=`echo "((${EXP})-(${OUT}))" | bc -l`
+                echo "'${RUN} ${NODE}','${EXP}','${OUT}','${ERR}'" >> dagenc.test
+            done
+    done
+
+eval "rm -r results"
+eval "rm A.enc B.enc C.enc Y.enc Z.enc W.enc job.json"
+eval "rm private_keys.json"
+eval "rm public_key.json"
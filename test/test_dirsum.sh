@@ -0,0 +1,70 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+eval "mkdir -p day1 day2 broken"
+
+# integer ciphertexts in two directories, halves in the second one
+SUM=0
+for i in `seq 1 300`;
+    do
+        X=`echo $(( $(( $RANDOM - $RANDOM )) % 100000 ))`
+        eval "../bin/encrypt -p private_keys.json -o day1/r${i}.enc -v ${X}"
+        SUM=`echo "${SUM} + ${X}" | bc -l`
+    done
+for i in `seq 1 40`;
+    do
+        X=`echo "$(( $RANDOM - $RANDOM ))/2" | bc -l`
+        eval "../bin/encrypt -p private_keys.json -o day2/r${i}.enc -v ${X}"
+        SUM=`echo "${SUM} + ${X}" | bc -l`
+    done
+COUNT=340
+
+# ciphertexts padded past the size read through io_uring, read by the workers instead
+for i in `seq 1 3`;
+    do
+        X=`echo $(( $RANDOM - $RANDOM ))`
+        eval "../bin/encrypt -p private_keys.json -o day2/big${i}.enc -v ${X}"
+        head -c 70000 /dev/zero | tr '\0' ' ' >> day2/big${i}.enc
+        SUM=`echo "${SUM} + ${X}" | bc -l`
+        COUNT=$(( COUNT + 1 ))
+    done
+
+# files without the suffix and a directory with it are skipped
+echo "not a ciphertext" > day1/notes.txt
+cp day1/r1.enc day1/r1.enc.bak
+eval "mkdir -p day1/archive.enc"
+cp day1/r2.enc day1/archive.enc/r2.enc
+
+# a file with the suffix that is not a ciphertext fails the run without output
+cp day1/r1.enc broken/r1.enc
+echo "not a ciphertext" > broken/notes.enc
+
+echo "'reader','sum','count','d(e(sum))','summed count','error'" >> dirsum.test
+echo "'reader','result'" >> dirsum_invalid.test
+
+# --no-uring takes the same plain-read path as a build with AHEF_NO_IO_URING
+for READER in uring no-uring;
+    do
+        if [ ${READER} = uring ]; then OPT=""; else OPT="--no-uring"; fi
+
+        eval "../bin/dirsum -p public_key.json -d day1 -d day2 -o total.json -t 4 ${OPT}"
+        OUT=`eval "../bin/decrypt -p private_keys.json -c total.json -f sum"`
+        OUT_COUNT=`sed -n 's/.*"count": \([0-9]*\).*/\1/p' total.json`
+        ERR=`echo "((${SUM})-(${OUT}))" | bc -l`
+        echo "'${READER}','${SUM}','${COUNT}','${OUT}','${OUT_COUNT}','${ERR}'" >> dirsum.test
+        rm -f total.json
+
+        if eval "../bin/dirsum -p public_key.json -d broken -o total.json ${OPT}" 2> /dev/null;
+            then RESULT="accepted"
+            else RESULT="rejected"
+        fi
+        if [ -e total.json ]; then RESULT="${RESULT}, output written"; fi
+        echo "'${READER}','${RESULT}'" >> dirsum_invalid.test
+        rm -f total.json
+    done
+
+eval "rm -r day1 day2 broken"
+eval "rm private_keys.json"
+eval "rm public_key.json"
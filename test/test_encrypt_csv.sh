@@ -0,0 +1,51 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'id','plain','decrypt','error'" >> encrypt_csv.test
+
+# quoted notes with delimiters, doubled quotes and line breaks, CRLF records
+printf 'order_id,note,amount\r\n' > sales.csv
+for i in `seq 1 500`;
+    do
+        AMOUNT=`echo "$(( $RANDOM - $RANDOM ))/$(( $RANDOM % 8 + 1 ))" | bc -l`
+        case $(( $RANDOM % 4 )) in
+            0) NOTE="plain" ;;
+            1) NOTE="\"with, comma\"" ;;
+            2) NOTE="\"say \"\"hi\"\"\"" ;;
+            3) NOTE="\"two
+lines, ${i}\"" ;;
+        esac
+        printf 'o%d,%s,%s\r\n' ${i} "${NOTE}" ${AMOUNT} >> sales.csv
+        echo "o${i} ${AMOUNT}" >> plain.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json --csv sales.csv -c amount --rowId order_id -o amount.col -t 4"
+eval "../bin/decrypt -p private_keys.json -C amount.col" > amount.txt
+
+while read ID OUT;
+    do
+        IN=`awk -v k=${ID} '$1 == k { print $2 }' plain.txt`
+        ERR=`echo "((${IN})-(${OUT}))" | bc -l`
+        echo "'${ID}','${IN}','${OUT}','${ERR}'" >> encrypt_csv.test
+    done < amount.txt
+
+# a non-number, a non-finite number or an empty cell fails the run without output
+echo "'cell','result'" >> encrypt_csv_invalid.test
+for CELL in "NaN" "inf" "" "x1";
+    do
+        printf 'order_id,amount\no1,1.5\no2,%s\no3,2\n' "${CELL}" > invalid.csv
+        if eval "../bin/encrypt -p private_keys.json --csv invalid.csv -c amount --rowId order_id -o invalid.col" 2> /dev/null;
+            then RESULT="accepted"
+            else RESULT="rejected"
+        fi
+        if [ -e invalid.col ]; then RESULT="${RESULT}, output written"; fi
+        echo "'${CELL}','${RESULT}'" >> encrypt_csv_invalid.test
+        rm -f invalid.col
+    done
+
+eval "rm sales.csv plain.txt amount.col amount.txt"
+eval "rm invalid.csv"
+eval "rm private_keys.json"
+eval "rm public_key.json"
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'row','(x+y)*z-w','d(e(...))','error'" >> evalenc.test
+
+for i in `seq 1 500`;
+    do
+        echo $(( $RANDOM % 2000 - 1000 )) >> X.txt
+        echo $(( $RANDOM % 2000 - 1000 )) >> Y.txt
+        echo $(( $RANDOM % 2000 - 1000 )) >> Z.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i X.txt -o X.col"
+eval "../bin/encrypt -p private_keys.json -i Y.txt -o Y.col"
+eval "../bin/encrypt -p private_keys.json -i Z.txt -o Z.col"
+eval "../bin/encrypt -p private_keys.json -o W.enc -v 7"
+
+# columns X, Y, Z and the ciphertext W, which applies to every row
+eval "../bin/evalenc -p public_key.json -C X=X.col -C Y=Y.col -C Z=Z.col -c W=W.enc -o R.col '(X + Y) * Z - W' --stats"
+eval "../bin/decrypt -p private_keys.json -C R.col" > R.txt
+
+paste -d' ' X.txt Y.txt Z.txt | awk '{ print ($1 + $2) * $3 - 7 }' > expected.txt
+
+ROW=0
+paste -d' ' expected.txt R.txt | while read EXP OUT;
+    do
+        ROW=$(( ROW + 1 ))
+        ERR=`echo "((${EXP})-(${OUT}))" | bc -l`
+        echo "'${ROW}','${EXP}','${OUT}','${ERR}'" >> evalenc.test
+    done
+
+# single ciphertexts, repeated operands and plaintext numbers
+eval "../bin/encrypt -p private_keys.json -o A.enc -v 2.5"
+eval "../bin/encrypt -p private_keys.json -o B.enc -v 4"
+eval "../bin/evalenc -p public_key.json -c A=A.enc -c B=B.enc -o C.enc 'A*B + A*B - 2*B + 0.5' --stats"
+OUT=`../bin/decrypt -p private_keys.json -c C.enc`
+ERR=`echo "((12.5)-(${OUT}))" | bc -l`
+echo "'single','12.5','${OUT}','${ERR}'" >> evalenc.test
+
+eval "rm X.txt Y.txt Z.txt X.col Y.col Z.col W.enc R.col R.txt expected.txt A.enc B.enc C.enc"
+eval "rm private_keys.json"
+eval "rm public_key.json"
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'id','A','B','C','A*B+C','d(e(A*B+C))','error'" >> fmaenc.test
+
+for i in `seq 1 200`;
+    do
+        NUM=`echo $(( $(( $RANDOM - $RANDOM )) % 10000000 ))`
+        DENOM=`echo $(( $[$RANDOM % 1000] + 1))`
+        A=`echo "${NUM}/${DENOM}" | bc -l`
+        eval "../bin/encrypt -p private_keys.json -o A.enc -v ${A}"
+
+        NUM=`echo $(( $(( $RANDOM - $RANDOM )) % 10000000 ))`
+        DENOM=`echo $(( $[$RANDOM % 1000] + 1))`
+        B=`echo "${NUM}/${DENOM}" | bc -l`
+        eval "../bin/encrypt -p private_keys.json -o B.enc -v ${B}"
+
+        NUM=`echo $(( $(( $RANDOM - $RANDOM )) % 10000000 ))`
+        DENOM=`echo $(( $[$RANDOM % 1000] + 1))`
+        C=`echo "${NUM}/${DENOM}" | bc -l`
+        eval "../bin/encrypt -p private_keys.json -o C.enc -v ${C}"
+
+        D=`echo "(${A}) * (${B}) + (${C})" | bc -l`
+        eval "../bin/fmaenc -p public_key.json -a A.enc -b B.enc -c C.enc -o D.enc"
+
+        OUT=`eval "../bin/decrypt -p private_keys.json -c D.enc"`
+        ERR=`echo "(($D)-($OUT))" | bc -l`
+        echo "'${i}','${A}','${B}','${C}','${D}','${OUT}','${ERR}'" >> fmaenc.test
+    done
+
+# column mode on fractional values
+echo "'row','A','B','C','A*B+C','d(e(A*B+C))','error'" >> fmaenc_columns.test
+
+for i in `seq 1 500`;
+    do
+        echo "$(( $RANDOM - $RANDOM )).$(( $RANDOM % 1000 ))" >> a.txt
+        echo "$(( $RANDOM % 2000 - 1000 )).$(( $RANDOM % 100 ))" >> b.txt
+        echo "$(( $RANDOM - $RANDOM )).$(( $RANDOM % 10000 ))" >> c.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i a.txt -o a.col"
+eval "../bin/encrypt -p private_keys.json -i b.txt -o b.col"
+eval "../bin/encrypt -p private_keys.json -i c.txt -o c.col"
+eval "../bin/fmaenc -p public_key.json -A a.col -B b.col -C c.col -o d.col -t 4"
+eval "../bin/decrypt -p private_keys.json -C d.col" > d.txt
+
+ROW=0
+paste -d' ' a.txt b.txt c.txt d.txt | while read A B C OUT;
+    do
+        ROW=$(( ROW + 1 ))
+        D=`echo "(${A}) * (${B}) + (${C})" | bc -l`
+        ERR=`echo "((${D})-(${OUT}))" | bc -l`
+        echo "'${ROW}','${A}','${B}','${C}','${D}','${OUT}','${ERR}'" >> fmaenc_columns.test
+    done
+
+eval "rm A.enc B.enc C.enc D.enc"
+eval "rm a.txt b.txt c.txt a.col b.col c.col d.col d.txt"
+eval "rm private_keys.json"
+eval "rm public_key.json"
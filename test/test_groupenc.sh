@@ -0,0 +1,28 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'key','sum','d(e(sum))','error'" >> groupenc.test
+
+for i in `seq 1 2000`;
+    do
+        echo "k$(( $RANDOM % 20 ))" >> keys.txt
+        echo $(( $RANDOM % 100000 )) >> values.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i values.txt -o values.col"
+paste -d' ' keys.txt values.col > keyed.col
+eval "../bin/groupenc -p public_key.json -c keyed.col -o sums.col -t 4"
+eval "../bin/decrypt -p private_keys.json -C sums.col" > sums.txt
+
+while read KEY OUT;
+    do
+        SUM=`paste -d' ' keys.txt values.txt | awk -v k=${KEY} '$1 == k { s += $2 } END { print s }'`
+        ERR=`echo "((${SUM})-(${OUT}))" | bc -l`
+        echo "'${KEY}','${SUM}','${OUT}','${ERR}'" >> groupenc.test
+    done < sums.txt
+
+eval "rm keys.txt values.txt values.col keyed.col sums.col sums.txt"
+eval "rm private_keys.json"
+eval "rm public_key.json"
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'kind','i','j','A*B','d(e(A*B))','error'" >> matenc.test
+
+# integers take the delayed reduction path (all denominators 1), fractions the per-term one;
+# the fractional right side is a vector
+for KIND in int frac;
+    do
+        if [ ${KIND} = int ]; then
+            R=12; K=9; C=7
+        else
+            R=10; K=8; C=1
+        fi
+
+        for i in `seq 1 $(( R * K ))`;
+            do
+                if [ ${KIND} = int ]; then
+                    echo $(( $RANDOM - $RANDOM )) >> A.txt
+                else
+                    echo "$(( $RANDOM - $RANDOM ))/4" | bc -l >> A.txt
+                fi
+            done
+        for i in `seq 1 $(( K * C ))`;
+            do
+                if [ ${KIND} = int ]; then
+                    echo $(( $RANDOM % 2000 - 1000 )) >> B.txt
+                else
+                    echo "$(( $RANDOM % 2000 - 1000 ))/8" | bc -l >> B.txt
+                fi
+            done
+
+        eval "../bin/encrypt -p private_keys.json -i A.txt -o A.col"
+        eval "../bin/encrypt -p private_keys.json -i B.txt -o B.col"
+        (echo "#matrix ${R} ${K}"; cat A.col) > A.mat
+        (echo "#matrix ${K} ${C}"; cat B.col) > B.mat
+        eval "../bin/matenc -p public_key.json -a A.mat -b B.mat -o C.mat -t 4 --tile 4"
+        tail -n +2 C.mat > C.col
+        eval "../bin/decrypt -p private_keys.json -C C.col" > C.txt
+
+        # plaintext product in row-major order
+        awk -v r=${R} -v k=${K} -v c=${C} 'NR == FNR { a[NR - 1] = $1; next } { b[FNR - 1] = $1 }
+            END { for (i = 0; i < r; ++i) for (j = 0; j < c; ++j) { s = 0; for (l = 0; l < k; ++l) s += a[i * k + l] * b[l * c + j]; printf "%.6f\n", s } }' A.txt B.txt > expected.txt
+
+        N=0
+        paste -d' ' expected.txt C.txt | while read PROD OUT;
+            do
+                ERR=`echo "((${PROD})-(${OUT}))" | bc -l`
+                echo "'${KIND}','$(( N / C + 1 ))','$(( N % C + 1 ))','${PROD}','${OUT}','${ERR}'" >> matenc.test
+                N=$(( N + 1 ))
+            done
+
+        eval "rm A.txt B.txt A.col B.col A.mat B.mat C.mat C.col C.txt expected.txt"
+    done
+
+eval "rm private_keys.json"
+eval "rm public_key.json"
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'mode','sum','d(e(sum))','error'" >> mergeagg.test
+
+for i in `seq 1 1000`;
+    do
+        echo $(( $RANDOM % 20000 - 10000 )) >> values.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i values.txt -o values.col"
+SUM=`awk '{ s += $1 } END { print s }' values.txt`
+
+# single process, forked shards, and shard partials merged in reverse order
+eval "../bin/statenc -p public_key.json -c values.col -o single.json -t 4"
+eval "../bin/statenc -p public_key.json -c values.col -o forked.json --shards 4 -t 4"
+for i in `seq 0 2`;
+    do
+        eval "../bin/statenc -p public_key.json -c values.col -o part${i}.json --shard ${i}/3 -t 1"
+    done
+eval "../bin/mergeagg -p public_key.json -o merged.json part2.json part1.json part0.json"
+
+for MODE in single forked merged;
+    do
+        OUT=`../bin/decrypt -p private_keys.json -c ${MODE}.json -f sum`
+        ERR=`echo "((${SUM})-(${OUT}))" | bc -l`
+        echo "'${MODE}','${SUM}','${OUT}','${ERR}'" >> mergeagg.test
+    done
+
+# a missing shard must be rejected
+if ../bin/mergeagg -p public_key.json -o missing.json part0.json part2.json 2> /dev/null;
+    then
+        echo "'missing shard','error','merged','1'" >> mergeagg.test
+    fi
+
+eval "rm values.txt values.col single.json forked.json part0.json part1.json part2.json merged.json"
+eval "rm -f missing.json"
+eval "rm private_keys.json"
+eval "rm public_key.json"
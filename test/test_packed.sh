@@ -0,0 +1,34 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'id','lane','A','B','A + B','d(e(A) + e(B))','error'" >> packed.test
+
+for i in `seq 1 100`;
+    do
+        A=()
+        B=()
+        for LANE in `seq 0 7`;
+            do
+                A+=(`echo $(( $RANDOM * $RANDOM - $RANDOM * $RANDOM ))`)
+                B+=(`echo $(( $RANDOM * $RANDOM - $RANDOM * $RANDOM ))`)
+            done
+        eval "../bin/encrypt -p private_keys.json -o A.enc --packed \"${A[*]}\" --laneBits 40"
+        eval "../bin/encrypt -p private_keys.json -o B.enc --packed \"${B[*]}\" --laneBits 40"
+        eval "../bin/addenc -p public_key.json -a A.enc -b B.enc -o C.enc"
+
+        OUT=(`eval "../bin/decrypt -p private_keys.json -c C.enc --lanes 8 --laneBits 40"`)
+        for LANE in `seq 0 7`;
+            do
+                C=`echo "${A[$LANE]} + ${B[$LANE]}" | bc`
+                ERR=`echo "${C} - ${OUT[$LANE]}" | bc`
+                echo "'${i}','${LANE}','${A[$LANE]}','${B[$LANE]}','${C}','${OUT[$LANE]}','${ERR}'" >> packed.test
+            done
+    done
+
+eval "rm A.enc"
+eval "rm B.enc"
+eval "rm C.enc"
+eval "rm private_keys.json"
+eval "rm public_key.json"
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'id','A','k','A^k','d(e(A)^k)','error'" >> powenc.test
+
+for i in `seq 1 100`;
+    do
+        NUM=`echo $(( $RANDOM % 2000 - 1000 ))`
+        if [ ${NUM} -eq 0 ]; then
+            NUM=1
+        fi
+        DENOM=`echo $(( $[$RANDOM % 100] + 1))`
+        A=`echo "${NUM}/${DENOM}" | bc -l`
+        eval "../bin/encrypt -p private_keys.json -o A.enc -v ${A}"
+
+        for K in -3 -1 0 1 2 4;
+            do
+                C=`echo "(${A}) ^ (${K})" | bc -l`
+                eval "../bin/powenc -p public_key.json -k ${K} -c A.enc -o C.enc"
+
+                OUT=`eval "../bin/decrypt -p private_keys.json -c C.enc"`
+                ERR=`echo "(($C)-($OUT))" | bc -l`
+                echo "'${i}','${A}','${K}','${C}','${OUT}','${ERR}'" >> powenc.test
+            done
+    done
+
+eval "rm A.enc"
+eval "rm C.enc"
+eval "rm private_keys.json"
+eval "rm public_key.json"
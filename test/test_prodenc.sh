@@ -0,0 +1,36 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'id','n','product','d(e(product))','error','tree = chain'" >> prodenc.test
+
+for i in `seq 1 100`;
+    do
+        N=`echo $(( $[$RANDOM % 20] + 1))`
+        P=1
+        FILES=""
+        for j in `seq 1 ${N}`;
+            do
+                NUM=`echo $(( $(( $RANDOM - $RANDOM )) % 1000 ))`
+                DENOM=`echo $(( $[$RANDOM % 100] + 1))`
+                X=`echo "${NUM}/${DENOM}" | bc -l`
+                P=`echo "(${P}) * (${X})" | bc -l`
+                eval "../bin/encrypt -p private_keys.json -o X${j}.enc -v ${X}"
+                FILES="${FILES} X${j}.enc"
+            done
+
+        eval "../bin/prodenc -p public_key.json -o T.enc -t 4 ${FILES}"
+        eval "../bin/prodenc -p public_key.json -o S.enc --sequential ${FILES}"
+        SAME=`diff <(grep -v created T.enc) <(grep -v created S.enc) > /dev/null && echo 1 || echo 0`
+
+        OUT=`eval "../bin/decrypt -p private_keys.json -c T.enc"`
+        ERR=`echo "((${P})-(${OUT}))" | bc -l`
+        echo "'${i}','${N}','${P}','${OUT}','${ERR}','${SAME}'" >> prodenc.test
+        eval "rm ${FILES}"
+    done
+
+eval "rm T.enc"
+eval "rm S.enc"
+eval "rm private_keys.json"
+eval "rm public_key.json"
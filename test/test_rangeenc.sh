@@ -0,0 +1,41 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'range','sum','d(e(sum))','error'" >> rangeenc.test
+
+for i in `seq 1 1000`;
+    do
+        echo $(( $RANDOM % 20000 - 10000 )) >> values.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i values.txt -o values.col"
+
+# build the index in two appends
+head -n 600 values.col > first.col
+tail -n 400 values.col > second.col
+eval "../bin/rangeenc -p public_key.json -i values.idx -a first.col"
+eval "../bin/rangeenc -p public_key.json -i values.idx -a second.col"
+
+for i in `seq 1 50`;
+    do
+        A=$(( $RANDOM % 1000 + 1 ))
+        B=$(( $RANDOM % 1000 + 1 ))
+        if [ ${A} -gt ${B} ]; then T=${A}; A=${B}; B=${T}; fi
+        echo "${A}:${B}" >> ranges.txt
+    done
+
+eval "../bin/rangeenc -p public_key.json -i values.idx `sed 's/^/-r /' ranges.txt | tr '\n' ' '` -o sums.col"
+eval "../bin/decrypt -p private_keys.json -C sums.col" > sums.txt
+
+paste -d' ' ranges.txt sums.txt | while read RANGE OUT;
+    do
+        SUM=`awk -v r=${RANGE} 'BEGIN { split(r, ab, ":") } NR >= ab[1] && NR <= ab[2] { s += $1 } END { print s }' values.txt`
+        ERR=`echo "((${SUM})-(${OUT}))" | bc -l`
+        echo "'${RANGE}','${SUM}','${OUT}','${ERR}'" >> rangeenc.test
+    done
+
+eval "rm values.txt values.col first.col second.col values.idx values.idx.lock ranges.txt sums.col sums.txt"
+eval "rm private_keys.json"
+eval "rm public_key.json"
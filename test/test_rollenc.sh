@@ -0,0 +1,31 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'step','sum','d(e(sum))','error'" >> rollenc.test
+
+WINDOW=50
+for i in `seq 1 1000`;
+    do
+        echo $(( $RANDOM % 20000 - 10000 )) >> values.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i values.txt -o values.col"
+eval "../bin/rollenc -p public_key.json -c values.col -w ${WINDOW} -o window.col"
+eval "../bin/decrypt -p private_keys.json -C window.col" > window.txt
+
+# plaintext rolling sums of the same window
+awk -v w=${WINDOW} '{ s += $1; x[NR] = $1; if (NR > w) s -= x[NR - w]; print s }' values.txt > expected.txt
+
+STEP=0
+paste -d' ' expected.txt window.txt | while read SUM OUT;
+    do
+        STEP=$(( STEP + 1 ))
+        ERR=`echo "((${SUM})-(${OUT}))" | bc -l`
+        echo "'${STEP}','${SUM}','${OUT}','${ERR}'" >> rollenc.test
+    done
+
+eval "rm values.txt values.col window.col window.txt expected.txt"
+eval "rm private_keys.json"
+eval "rm public_key.json"
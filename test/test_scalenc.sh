@@ -0,0 +1,39 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'id','op','A','k','A op k','d(e(A) op k)','error'" >> scalenc.test
+
+for i in `seq 1 500`;
+    do
+        NUM=`echo $(( $(( $RANDOM - $RANDOM )) % 10000000 ))` 
+        DENOM=`echo $(( $[$RANDOM % 1000] + 1))`
+        A=`echo "${NUM}/${DENOM}" | bc -l`
+        eval "../bin/encrypt -p private_keys.json -o A.enc -v ${A}"
+
+        NUM=`echo $(( $(( $RANDOM - $RANDOM )) % 10000 ))` 
+        DENOM=`echo $(( $[$RANDOM % 100] + 1))`
+        K=`echo "${NUM}/${DENOM}" | bc -l`
+
+        for OP in add sub mul div;
+            do
+                case ${OP} in
+                    add) SYM="+" ;;
+                    sub) SYM="-" ;;
+                    mul) SYM="*" ;;
+                    div) SYM="/" ;;
+                esac
+                C=`echo "(${A}) ${SYM} (${K})" | bc -l`
+                eval "../bin/scalenc -p public_key.json -m ${OP} -k ${K} -c A.enc -o C.enc"
+
+                OUT=`eval "../bin/decrypt -p private_keys.json -c C.enc"`
+                ERR=`echo "(($C)-($OUT))" | bc -l`
+                echo "'${i}','${OP}','${A}','${K}','${C}','${OUT}','${ERR}'" >> scalenc.test
+            done
+    done 
+
+eval "rm A.enc"
+eval "rm C.enc"
+eval "rm private_keys.json"
+eval "rm public_key.json"
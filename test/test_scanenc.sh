@@ -0,0 +1,29 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'i','sum','d(e(sum))','error'" >> scanenc.test
+
+for i in `seq 1 1000`;
+    do
+        echo $(( $RANDOM % 20000 - 10000 )) >> values.txt
+    done
+
+eval "../bin/encrypt -p private_keys.json -i values.txt -o values.col"
+eval "../bin/scanenc -p public_key.json -c values.col -o prefix.col -t 4"
+eval "../bin/decrypt -p private_keys.json -C prefix.col" > prefix.txt
+
+awk '{ s += $1; print s }' values.txt > expected.txt
+
+I=0
+paste -d' ' expected.txt prefix.txt | while read SUM OUT;
+    do
+        I=$(( I + 1 ))
+        ERR=`echo "((${SUM})-(${OUT}))" | bc -l`
+        echo "'${I}','${SUM}','${OUT}','${ERR}'" >> scanenc.test
+    done
+
+eval "rm values.txt values.col prefix.col prefix.txt expected.txt"
+eval "rm private_keys.json"
+eval "rm public_key.json"
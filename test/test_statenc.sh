@@ -0,0 +1,36 @@
+#!/bin/bash
+
+eval "../bin/genpkey -o private_keys.json -k 1024"
+eval "../bin/extract -i private_keys.json -o public_key.json"
+
+echo "'n','sum','sumOfSquares','d(sum)','d(sumOfSquares)','error sum','error sumOfSquares'" >> statenc.test
+
+for n in `seq 10 10 100`;
+    do
+        SUM=0
+        SQ=0
+        eval "rm -f X.col"
+        for i in `seq 1 ${n}`;
+            do
+                NUM=`echo $(( $RANDOM % 100000 ))`
+                DENOM=`echo $(( $[$RANDOM % 1000] + 1))`
+                X=`echo "${NUM}/${DENOM}" | bc -l`
+                eval "../bin/encrypt -p private_keys.json -o X.enc -v ${X}"
+                echo "`sed -n 's/.*"numerator": "\(.*\)".*/\1/p' X.enc` `sed -n 's/.*"denominator": "\(.*\)".*/\1/p' X.enc`" >> X.col
+                SUM=`echo "${SUM} + ${X}" | bc -l`
+                SQ=`echo "${SQ} + ${X}^2" | bc -l`
+            done
+        eval "../bin/statenc -p public_key.json -c X.col -o S.json"
+
+        OUT_SUM=`eval "../bin/decrypt -p private_keys.json -c S.json -f sum"`
+        OUT_SQ=`eval "../bin/decrypt -p private_keys.json -c S.json -f sumOfSquares"`
+        ERR_SUM=`echo "(($SUM)-($OUT_SUM))" | bc -l`
+        ERR_SQ=`echo "(($SQ)-($OUT_SQ))" | bc -l`
+        echo "'${n}','${SUM}','${SQ}','${OUT_SUM}','${OUT_SQ}','${ERR_SUM}','${ERR_SQ}'" >> statenc.test
+    done
+
+eval "rm X.enc"
+eval "rm X.col"
+eval "rm S.json"
+eval "rm private_keys.json"
+eval "rm public_key.json"